@@ -7,126 +7,558 @@
 #include <math.h>
 #include <string.h>
 #include <stdarg.h>
+#include <limits.h>
+#include <signal.h>
 #include <random>
+#include <queue>
+#include <vector>
 
-#define NUM_STATIONS 4
-#define MAX_OPERATIVES 100
+#include "../event_log.h"
+#include "../logbook.h"
+#include "../stations.h"
+#include "../sim_random.h"
+#include "../sync_backend.h"
+#include "../coro_executor.h"
+#include "../arrivals.h"
+#include "../timeline.h"
+#include "../live_metrics.h"
 
-int N, M, x, y;
-int completed_operations = 0;
-int operatives_completed[MAX_OPERATIVES] = {0};
-int unit_completion_count[MAX_OPERATIVES] = {0};
+// Exit report on stderr: table, json or one csv row (read by sim_bench)
+enum { METRICS_TABLE, METRICS_JSON, METRICS_CSV };
+int metrics_format = METRICS_TABLE;
 
-pthread_mutex_t output_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t unit_mutex = PTHREAD_MUTEX_INITIALIZER;
+// --live: counters in a shared memory segment for simtop, shared by all runs
+LiveMetrics *live_metrics = NULL;
 
-sem_t stations[NUM_STATIONS];
-sem_t write_sem;
-pthread_mutex_t read_count_mutex = PTHREAD_MUTEX_INITIALIZER;
-int read_count = 0;
+// Which queued operative a freed station seat goes to: arrival order, members
+// of the unit with the fewest operatives still typing, or members of the unit
+// whose first member arrived earliest. The last two shorten the critical path
+// of units that are almost done.
+enum { ADMIT_FIFO, ADMIT_FEWEST_LEFT, ADMIT_EARLIEST_UNIT };
+const char *admission_names[] = {"fifo", "fewest-left", "earliest-unit"};
 
-struct timespec start_time;
+// Everything that defines one run; the same config can start many runs
+typedef struct
+{
+    int N, M, x, y;
+    uint64_t seed;
+    int log_events; // print event lines (off for --scenarios)
+
+    // Pool mode: operatives and staff run as tasks on a fixed set of workers
+    int use_pool;
+    int pool_workers;
+    // Virtual mode: pool tasks replayed in due-time order against a simulated clock
+    int use_virtual_clock;
+    // Coroutine mode: operatives and staff are C++20 coroutines (coro_executor.h)
+    int use_coro;
+
+    // Stations and the dispatch policy (stations.h), logbook policy (logbook.h)
+    int num_stations;
+    int station_capacity;
+    int station_dispatch;
+    int station_admission;
+    int logbook_policy;
+
+    // Semaphores and latches behind stations and units (sync_backend.h)
+    int sync_backend;
+
+    // Where arrivals come from (arrivals.h); the trace path is checked by main.
+    // With a source, the source decides how many operatives arrive and N only
+    // seeds the staff and arrival streams
+    int arrival_kind;
+    double arrival_rate;
+    long long arrival_limit;
+    const char *arrival_trace;
+} SimConfig;
+
+typedef struct Simulation Simulation;
+
+typedef struct Task
+{
+    void (*run)(struct Task *);
+    Simulation *sim;
+    long long due_us;
+    unsigned long long seq;
+    struct Task *next; // link while parked in a station/logbook wait queue
+    long long wait_start_us;
+} Task;
 
+// Per-unit countdown: members decrement it, the leader sleeps until it hits 0.
+// Created with the unit's first member, freed by the last member done with it
 typedef struct
 {
+    SyncLatch latch;
+#if CORO_AVAILABLE
+    CoroLatch coro; // coro mode counts down this one instead
+#endif
+    long long first_arrival_us;
+    long long logbook_asked_us; // --live: when the leader queued for the logbook
+    struct Operative *leader;   // set when the last member is created
+    int refs;                   // members not done yet
+} UnitLatch;
+
+// Created when it arrives (or up front without an arrival source), freed once
+// done: after typing, or for the leader after logging its unit
+typedef struct Operative
+{
+    Task task; // must stay first, tasks are cast back to their owner
     int id;
     int unit_id;
+    UnitLatch *unit;
     int is_leader;
-    int station_id;
+    int home_station; // ID mod station count
+    int station_id;   // station actually used, chosen on arrival
     int arrival_time;
+    SimRng rng; // stream = operative ID
+    long long typing_start_us;
 } Operative;
 
-void init_timing()
+typedef struct
+{
+    Task task;
+    int staff_id;
+    double read_interval;
+    SimRng rng; // stream = N + staff ID
+} StaffTask;
+
+// Pool mode arrival source: one pending task that brings in the next operative
+typedef struct
+{
+    Task task;
+} ArrivalTask;
+
+typedef struct
+{
+    Task *head;
+    Task *tail;
+} TaskQueue;
+
+// Guarded by the station's lock in the StationSet; under priority admission
+// operatives wait in its AdmitQueue instead of waiting
+typedef struct
+{
+    int busy; // operatives typing, up to the station capacity
+    TaskQueue waiting;
+} PoolStation;
+
+struct TaskLater
+{
+    bool operator()(const Task *a, const Task *b) const
+    {
+        if (a->due_us != b->due_us)
+            return a->due_us > b->due_us;
+        return a->seq > b->seq;
+    }
+};
+
+/*
+ * One run of the simulation: its parameters, clock, synchronization
+ * primitives, pool scheduler and metrics. Runs share no state, so any number
+ * of them can execute side by side in one process (see run_scenarios).
+ */
+struct Simulation
+{
+    int N, M, x, y;
+    uint64_t seed;
+    int log_events;
+    Timeline *timeline; // --timeline: spans for a Chrome trace, else NULL
+    LiveMetrics *live;  // --live: counters for simtop, else NULL
+    int live_readers;   // staff this run counts as reading right now
+    int use_pool;
+    int pool_workers;
+    int use_virtual_clock;
+    int use_coro;
+    int admission;
+    int sync_backend;
+
+    int completed_operations;
+    struct timespec start_time;
+
+    // Thread mode: set once every operative is done; staff waits end on it
+    pthread_mutex_t shutdown_lock;
+    pthread_cond_t shutdown_cond;
+    int shutdown;
+    long long sim_clock_us;
+
+    StationSet stations;
+    Logbook logbook;
+
+    // Injected arrivals: the source, and operative threads still running
+    ArrivalSource arrivals;
+    int operatives_left;
+
+    // Operatives and units created so far and the unit taking members, only
+    // written by whoever creates operatives; arrivals_done once there are no
+    // more to come
+    int operatives_started;
+    long long units_started;
+    UnitLatch *filling_unit;
+    int arrivals_done;
+#if CORO_AVAILABLE
+    CoroExecutor *coro_executor; // coro mode: runs every unit's CoroLatch
+#endif
+
+    // Per-unit end-to-end latency: first member arriving to the unit being logged
+    Histogram unit_latency;
+    long long last_unit_logged_us;
+
+    // Pool mode scheduler
+    std::priority_queue<Task *, std::vector<Task *>, TaskLater> pool_timers;
+    pthread_mutex_t pool_mutex;
+    pthread_cond_t pool_cond;
+    unsigned long long pool_seq;
+    int pool_live; // tasks that still have work left
+
+    PoolStation *pool_stations;
+    // Shared dispatch: one queue for all stations, guarded by stations.pick_lock
+    TaskQueue pool_shared_waiting;
+
+    // Task-level logbook; admission follows logbook.policy (see logbook.h)
+    pthread_mutex_t pool_logbook_mutex;
+    int pool_readers;
+    int pool_writer;
+    TaskQueue pool_waiting_readers;
+    TaskQueue pool_waiting_writers;
+};
+
+void init_timing(Simulation *sim)
 {
-    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    clock_gettime(CLOCK_MONOTONIC, &sim->start_time);
 }
-long long get_time_ms()
+long long get_time_us(Simulation *sim)
 {
+    if (sim->use_virtual_clock)
+        return sim->sim_clock_us;
+
     struct timespec current_time;
     clock_gettime(CLOCK_MONOTONIC, &current_time);
 
-    long long elapsed = (current_time.tv_sec - start_time.tv_sec) * 1000LL +
-                        (current_time.tv_nsec - start_time.tv_nsec) / 1000000LL;
+    long long elapsed = (current_time.tv_sec - sim->start_time.tv_sec) * 1000000LL +
+                        (current_time.tv_nsec - sim->start_time.tv_nsec) / 1000LL;
     return elapsed;
 }
-
-int generate_poisson(double lambda)
+long long get_time_ms(Simulation *sim)
 {
-    std::random_device rd;
-    std::mt19937 generator(rd());
-
-    std::poisson_distribution<int> poissonDist(lambda);
-    return poissonDist(generator);
+    return get_time_us(sim) / 1000;
 }
 
-void init_sync()
+// Live counters follow the event stream: every update is one atomic add. unit
+// is the leader's unit for the unit events
+void live_note(Simulation *sim, int type, UnitLatch *unit, long long now)
 {
-    for (int i = 0; i < NUM_STATIONS; i++)
+    LiveMetrics *live = sim->live;
+
+    switch (type)
     {
-        sem_init(&stations[i], 0, 1);
+    case EV_OPERATIVE_ARRIVED:
+        live_add(&live->arrived, 1);
+        break;
+    case EV_TYPING_STARTED:
+        live_add(&live->stations_busy, 1);
+        break;
+    case EV_TYPING_DONE:
+        live_add(&live->stations_busy, -1);
+        live_add(&live->typed, 1);
+        break;
+    case EV_UNIT_TYPING_DONE:
+        unit->logbook_asked_us = now;
+        live_add(&live->units_completed, 1);
+        live_add(&live->writers_waiting, 1);
+        break;
+    case EV_LEADER_LOGBOOK:
+        live_add(&live->writers_waiting, -1);
+        live_add(&live->writer_wait_us, now - unit->logbook_asked_us);
+        break;
+    case EV_UNIT_LOGGED:
+        live_add(&live->completed_operations, 1);
+        break;
+    case EV_STAFF_REVIEW:
+        __atomic_add_fetch(&sim->live_readers, 1, __ATOMIC_RELAXED);
+        live_add(&live->readers, 1);
+        break;
+    case TL_STAFF_REVIEW_DONE:
+        __atomic_sub_fetch(&sim->live_readers, 1, __ATOMIC_RELAXED);
+        live_add(&live->readers, -1);
+        break;
     }
+}
+
+// Event line stamped with the run's own clock, also kept for --timeline and --live
+// (unit events pass the leader's unit for it)
+void sim_event(Simulation *sim, int type, int a = 0, int b = 0, UnitLatch *unit = NULL)
+{
+    if (!sim->log_events && !sim->timeline && !sim->live)
+        return;
+    long long now = get_time_us(sim);
+    if (sim->log_events)
+        log_event(type, now, a, b);
+    if (sim->timeline)
+        timeline_record(sim->timeline, type, now, a, b);
+    if (sim->live)
+        live_note(sim, type, unit, now);
+}
+
+// Marks with no event line, such as the end of a staff review
+void sim_mark(Simulation *sim, int type, int a)
+{
+    if (!sim->timeline && !sim->live)
+        return;
+    long long now = get_time_us(sim);
+    if (sim->timeline)
+        timeline_record(sim->timeline, type, now, a);
+    if (sim->live)
+        live_note(sim, type, NULL, now);
+}
+
+// Station admission rank for a queued operative, smaller goes first
+long long admission_key(void *arg)
+{
+    Operative *op = (Operative *)arg;
+    Simulation *sim = op->task.sim;
+    UnitLatch *unit = op->unit;
+
+    if (sim->admission == ADMIT_FEWEST_LEFT)
+        return __atomic_load_n(&unit->latch.remaining, __ATOMIC_RELAXED);
+    if (sim->admission == ADMIT_EARLIEST_UNIT)
+        return __atomic_load_n(&unit->first_arrival_us, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// Draws from the actor's own stream, so a seed fixes every delay (sim_random.h)
+int generate_poisson(SimRng *rng, double lambda)
+{
+    return sim_poisson(rng, lambda);
+}
+
+UnitLatch *unit_create(Simulation *sim)
+{
+    UnitLatch *unit = (UnitLatch *)calloc(1, sizeof(UnitLatch));
+    sync_latch_init(&unit->latch, sim->sync_backend, sim->M);
+#if CORO_AVAILABLE
+    if (sim->use_coro)
+        coro_latch_init(&unit->coro, sim->coro_executor, sim->M);
+#endif
+    unit->first_arrival_us = LLONG_MAX;
+    unit->refs = sim->M;
+    __atomic_add_fetch(&sim->units_started, 1, __ATOMIC_RELAXED);
+    if (sim->live)
+        live_add(&sim->live->units_total, 1);
+    return unit;
+}
+
+// The next operative in ID order, starting a new unit with every M-th. Only
+// one thread at a time creates operatives (main, the injector task or
+// coroutine), so IDs and units are handed out in order
+Operative *operative_create(Simulation *sim)
+{
+    int i = sim->operatives_started++;
+    if (i % sim->M == 0)
+        sim->filling_unit = unit_create(sim);
+
+    Operative *op = (Operative *)calloc(1, sizeof(Operative));
+    op->task.sim = sim;
+    op->id = i + 1;
+    op->unit_id = i / sim->M;
+    op->unit = sim->filling_unit;
+    op->is_leader = ((i + 1) % sim->M == 0) ? 1 : 0;
+    if (op->is_leader)
+        op->unit->leader = op;
+    sim_rng_init_seeded(&op->rng, sim->seed, op->id);
+    op->home_station = i % sim->stations.count;
+    if (sim->live)
+        live_add(&sim->live->operatives_total, 1);
+    return op;
+}
+
+// Frees an operative at the end of its part, and its unit after the last
+// member: by then every count down and the leader's wait have returned
+void operative_done(Operative *op)
+{
+    Simulation *sim = op->task.sim;
+    UnitLatch *unit = op->unit;
+    free(op);
+    if (__atomic_sub_fetch(&unit->refs, 1, __ATOMIC_ACQ_REL) > 0)
+        return;
+    sync_latch_destroy(&unit->latch);
+#if CORO_AVAILABLE
+    if (sim->use_coro)
+        coro_latch_destroy(&unit->coro);
+#else
+    (void)sim;
+#endif
+    free(unit);
+}
+
+// Set by SIGINT or SIGTERM: a run with an arrival source stops taking arrivals
+// at the next unit boundary, finishes the units it has and reports
+volatile sig_atomic_t arrivals_stop = 0;
+
+void request_arrivals_stop(int signo)
+{
+    (void)signo;
+    arrivals_stop = 1;
+}
+
+// Next arrival time from the source; -1 once it runs out or a stop was asked
+// for, never in the middle of a unit (sources hold whole units, see
+// check_arrivals)
+int next_arrival(Simulation *sim, long long *at_us)
+{
+    if (arrivals_stop && sim->operatives_started % sim->M == 0)
+        return -1;
+    return arrivals_next(&sim->arrivals, at_us);
+}
+
+// No more operatives will be created; units_started is final from here on
+void arrivals_end(Simulation *sim)
+{
+    __atomic_store_n(&sim->arrivals_done, 1, __ATOMIC_RELEASE);
+}
+
+// Whether completed logged units are every unit the run will have
+int all_units_logged(Simulation *sim, int completed)
+{
+    return __atomic_load_n(&sim->arrivals_done, __ATOMIC_ACQUIRE) &&
+           completed >= __atomic_load_n(&sim->units_started, __ATOMIC_RELAXED);
+}
+
+// Returns 1 for the member whose completion finished the unit
+int unit_latch_count_down(UnitLatch *unit)
+{
+    return sync_latch_count_down(&unit->latch);
+}
+
+void unit_latch_wait(UnitLatch *unit)
+{
+    sync_latch_wait(&unit->latch);
+}
 
-    sem_init(&write_sem, 0, 1);
+// A unit's admission_key moves when a member arrives (earliest-unit) or
+// finishes typing (fewest-left): re-rank its members already queued for seats
+void rekey_unit(Operative *op, int admission)
+{
+    Simulation *sim = op->task.sim;
+    if (sim->admission == admission)
+        station_rekey(&sim->stations, op->unit_id, admission_key, op);
+}
+
+void note_arrival(Operative *op)
+{
+    Simulation *sim = op->task.sim;
+    metrics_atomic_min(&op->unit->first_arrival_us, get_time_us(sim));
+    rekey_unit(op, ADMIT_EARLIEST_UNIT);
 }
 
-void cleanup_sync()
+void note_unit_logged(Operative *leader)
 {
-    for (int i = 0; i < NUM_STATIONS; i++)
+    Simulation *sim = leader->task.sim;
+    long long now = get_time_us(sim);
+    hist_record(&sim->unit_latency, now - leader->unit->first_arrival_us);
+    metrics_atomic_max(&sim->last_unit_logged_us, now);
+}
+
+void print_metrics(Simulation *sim, FILE *out)
+{
+    long long elapsed = get_time_us(sim);
+    Histogram *lat = &sim->unit_latency;
+    long long p50 = hist_percentile(lat, 50);
+    long long p95 = hist_percentile(lat, 95);
+    long long p99 = hist_percentile(lat, 99);
+    long long mean = lat->count ? lat->sum_us / lat->count : 0;
+
+    if (metrics_format == METRICS_CSV)
     {
-        sem_destroy(&stations[i]);
+        fprintf(out, "units,makespan_us,unit_p50_us,unit_p95_us,unit_p99_us,unit_max_us,unit_mean_us\n");
+        fprintf(out, "%lld,%lld,%lld,%lld,%lld,%lld,%lld\n", lat->count, sim->last_unit_logged_us,
+                p50, p95, p99, lat->max_us, mean);
+        return;
     }
-    sem_destroy(&write_sem);
+
+    if (metrics_format == METRICS_JSON)
+    {
+        fprintf(out, "{\"elapsed_us\": %lld, \"makespan_us\": %lld, ", elapsed, sim->last_unit_logged_us);
+        fprintf(out, "\"admission\": \"%s\", \"sync\": \"%s\", \"arrivals\": \"%s\", ",
+                admission_names[sim->admission], sync_backend_names[sim->sync_backend],
+                arrival_kind_names[sim->arrivals.kind]);
+        fprintf(out, "\"unit_latency_us\": {\"count\": %lld, \"mean\": %lld, \"p50\": %lld, "
+                     "\"p95\": %lld, \"p99\": %lld, \"max\": %lld}, ",
+                lat->count, mean, p50, p95, p99, lat->max_us);
+        stations_report_json(&sim->stations, elapsed, out);
+        fprintf(out, ", \"logbook\": ");
+        logbook_report_json(&sim->logbook, elapsed, out);
+        fprintf(out, "}\n");
+        return;
+    }
+
+    fprintf(out, "Units: %lld in %.3f s, %s admission, latency mean %.3f s, p50 %.3f s, p95 %.3f s, "
+                 "p99 %.3f s, max %.3f s\n",
+            lat->count, sim->last_unit_logged_us / 1e6, admission_names[sim->admission], mean / 1e6,
+            p50 / 1e6, p95 / 1e6, p99 / 1e6, lat->max_us / 1e6);
+    logbook_report(&sim->logbook, elapsed, out);
+    resource_report_header(out);
+    stations_report(&sim->stations, elapsed, out);
+    resource_report_row(out, "logbook", &sim->logbook.write_stats, elapsed);
 }
 
-int check_unit_completion(int unit_id)
+// Sleep for delay_us or until shutdown, whichever comes first; 1 on shutdown
+int staff_wait(Simulation *sim, long long delay_us)
 {
-    int start_operative = unit_id * M + 1;
-    int end_operative = (unit_id + 1) * M;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += delay_us / 1000000;
+    deadline.tv_nsec += (delay_us % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
 
-    for (int i = start_operative; i <= end_operative; i++)
+    pthread_mutex_lock(&sim->shutdown_lock);
+    while (!sim->shutdown &&
+           pthread_cond_timedwait(&sim->shutdown_cond, &sim->shutdown_lock, &deadline) == 0)
     {
-        if (!operatives_completed[i - 1])
-        {
-            return 0;
-        }
     }
-    return 1;
+    int stopped = sim->shutdown;
+    pthread_mutex_unlock(&sim->shutdown_lock);
+    return stopped;
+}
+
+void staff_shutdown(Simulation *sim)
+{
+    pthread_mutex_lock(&sim->shutdown_lock);
+    sim->shutdown = 1;
+    pthread_cond_broadcast(&sim->shutdown_cond);
+    pthread_mutex_unlock(&sim->shutdown_lock);
 }
 
 void *staff_reader_thread(void *arg)
 {
-    int staff_id = *(int *)arg;
-    double read_interval = staff_id == 1 ? 2.8 : 3.5;
+    StaffTask *s = (StaffTask *)arg;
+    Simulation *sim = s->task.sim;
+    int staff_id = s->staff_id;
+    double read_interval = s->read_interval;
 
     while (1)
     {
-        int delay = generate_poisson(read_interval) + 1;
-        usleep(delay * 1000000);
-
-        pthread_mutex_lock(&read_count_mutex);
-        read_count++;
-        if (read_count == 1)
+        int delay = generate_poisson(&s->rng, read_interval) + 1;
+        if (staff_wait(sim, delay * 1000000LL))
         {
-            sem_wait(&write_sem);
+            break;
         }
-        pthread_mutex_unlock(&read_count_mutex);
-        
-        pthread_mutex_lock(&output_mutex);
-        printf("Intelligence Staff %d began reviewing logbook at time %lld. Operations completed = %d\n",
-                   staff_id, get_time_ms() / 1000, completed_operations);
-        fflush(stdout);
-        pthread_mutex_unlock(&output_mutex);
 
-        usleep((generate_poisson(1.5) + 1) * 1000000);
+        logbook_read_lock(&sim->logbook);
 
-        pthread_mutex_lock(&read_count_mutex);
-        read_count--;
-        if (read_count == 0)
-        {
-            sem_post(&write_sem);
-        }
-        pthread_mutex_unlock(&read_count_mutex);
-        if (completed_operations >= N / M)
+        sim_event(sim, EV_STAFF_REVIEW, staff_id,
+                  logbook_read_value(&sim->logbook, &sim->completed_operations));
+
+        // Cut the read short on shutdown, but always leave through the unlock
+        int stopped = staff_wait(sim, (generate_poisson(&s->rng, 1.5) + 1) * 1000000LL);
+
+        // Read the count while the read is still held, not racing a writer
+        int completed = logbook_read_value(&sim->logbook, &sim->completed_operations);
+        sim_mark(sim, TL_STAFF_REVIEW_DONE, staff_id);
+        logbook_read_unlock(&sim->logbook);
+        if (stopped || all_units_logged(sim, completed))
         {
             break;
         }
@@ -137,150 +569,1457 @@ void *staff_reader_thread(void *arg)
 void *operative_thread(void *arg)
 {
     Operative *op = (Operative *)arg;
+    Simulation *sim = op->task.sim;
 
-    int arrival_delay = generate_poisson(2.0) + 1;
-    usleep(arrival_delay * 1000000);
-    pthread_mutex_lock(&output_mutex);
-    printf("Operative %d has arrived at typewriting station at time %lld\n",
-               op->id, get_time_ms() / 1000);
-    fflush(stdout);
-    pthread_mutex_unlock(&output_mutex);
+    // Injected operatives are started at their arrival time instead
+    if (sim->arrivals.kind == ARRIVAL_OPERATIVE)
+    {
+        int arrival_delay = generate_poisson(&op->rng, 2.0) + 1;
+        usleep(arrival_delay * 1000000);
+    }
+    sim_event(sim, EV_OPERATIVE_ARRIVED, op->id);
+    note_arrival(op);
 
-    // Blocking wait for station
-    sem_wait(&stations[op->station_id]);
+    // Blocking wait for a station picked by the dispatch policy
+    op->station_id = station_acquire(&sim->stations, op->home_station, &op->typing_start_us,
+                                     admission_key, op, op->unit_id);
 
-    pthread_mutex_lock(&output_mutex);
-    printf("Operative %d started document recreation at station TS%d at time %lld\n",
-               op->id, op->station_id + 1, get_time_ms() / 1000);
-    fflush(stdout);
-    pthread_mutex_unlock(&output_mutex);
+    sim_event(sim, EV_TYPING_STARTED, op->id, op->station_id + 1);
 
-    usleep(x * 100000);
+    usleep(sim->x * 100000);
 
-    pthread_mutex_lock(&output_mutex);
-    printf("Operative %d has completed document recreation at time %lld\n",
-               op->id, get_time_ms() / 1000);
-    fflush(stdout);
-    pthread_mutex_unlock(&output_mutex);
+    sim_event(sim, EV_TYPING_DONE, op->id);
 
-    pthread_mutex_lock(&unit_mutex);
-    operatives_completed[op->id - 1] = 1;
-    // Check if this operative is the last in their unit
-    if (check_unit_completion(op->unit_id)) {
-        unit_completion_count[op->unit_id] = 1;
-    }
-    pthread_mutex_unlock(&unit_mutex);
+    unit_latch_count_down(op->unit);
+    rekey_unit(op, ADMIT_FEWEST_LEFT);
 
-    sem_post(&stations[op->station_id]);
+    station_release(&sim->stations, op->station_id, op->typing_start_us);
 
     if (op->is_leader)
     {
-        // Blocking wait using mutex lock/unlock
-        while (1) {
-            pthread_mutex_lock(&unit_mutex);
-            if (unit_completion_count[op->unit_id]) {
-                pthread_mutex_unlock(&unit_mutex);
-                break;
+        // Sleeps until the last member of the unit counts the latch down
+        unit_latch_wait(op->unit);
+
+        sim_event(sim, EV_UNIT_TYPING_DONE, op->unit_id + 1, 0, op->unit);
+
+        logbook_write_lock(&sim->logbook);
+
+        sim_event(sim, EV_LEADER_LOGBOOK, op->unit_id + 1, op->id, op->unit);
+
+        usleep(sim->y * 1000000);
+        logbook_write_value(&sim->logbook, &sim->completed_operations, sim->completed_operations + 1);
+
+        sim_event(sim, EV_UNIT_LOGGED, op->unit_id + 1);
+        note_unit_logged(op);
+
+        logbook_write_unlock(&sim->logbook);
+    }
+
+    operative_done(op);
+    return NULL;
+}
+
+/*
+ * Pool mode
+ *
+ * Every operative and staff member is a small state machine (a Task) instead
+ * of a thread. A timed task sits in a min-heap ordered by due time and a fixed
+ * set of workers pops whatever is due and runs it. Nothing in a task blocks:
+ * a busy station or logbook parks the task in a wait queue, and whoever
+ * releases the resource hands it straight to the next waiter.
+ */
+
+void queue_push(TaskQueue *q, Task *t)
+{
+    t->next = NULL;
+    if (q->tail)
+        q->tail->next = t;
+    else
+        q->head = t;
+    q->tail = t;
+}
+
+Task *queue_pop(TaskQueue *q)
+{
+    Task *t = q->head;
+    if (t)
+    {
+        q->head = t->next;
+        if (!q->head)
+            q->tail = NULL;
+    }
+    return t;
+}
+
+// Park an operative for a seat: in arrival order under FIFO admission, else in
+// its unit's bucket of the seat's AdmitQueue (stations.h)
+void queue_push_admit(Simulation *sim, TaskQueue *q, AdmitQueue *admit, Operative *op)
+{
+    if (sim->admission == ADMIT_FIFO)
+        queue_push(q, &op->task);
+    else
+        admit_queue_push(admit, op->unit_id, admission_key(op), op);
+}
+
+// Next operative for a freed seat: queue head under FIFO admission, else the
+// one with the smallest admission_key (earliest queued on ties)
+Task *queue_pop_admit(Simulation *sim, TaskQueue *q, AdmitQueue *admit)
+{
+    if (sim->admission == ADMIT_FIFO)
+        return queue_pop(q);
+    if (admit_queue_empty(admit))
+        return NULL;
+    return &((Operative *)admit_queue_pop(admit))->task;
+}
+
+void pool_schedule(Task *t, long long delay_us)
+{
+    Simulation *sim = t->sim;
+    pthread_mutex_lock(&sim->pool_mutex);
+    t->due_us = get_time_us(sim) + delay_us;
+    t->seq = sim->pool_seq++;
+    sim->pool_timers.push(t);
+    pthread_cond_signal(&sim->pool_cond);
+    pthread_mutex_unlock(&sim->pool_mutex);
+}
+
+void pool_task_done(Simulation *sim)
+{
+    pthread_mutex_lock(&sim->pool_mutex);
+    if (--sim->pool_live == 0)
+        pthread_cond_broadcast(&sim->pool_cond);
+    pthread_mutex_unlock(&sim->pool_mutex);
+}
+
+void *pool_worker(void *arg)
+{
+    Simulation *sim = (Simulation *)arg;
+
+    pthread_mutex_lock(&sim->pool_mutex);
+    while (sim->pool_live > 0)
+    {
+        if (sim->pool_timers.empty())
+        {
+            pthread_cond_wait(&sim->pool_cond, &sim->pool_mutex);
+            continue;
+        }
+
+        Task *t = sim->pool_timers.top();
+        if (t->due_us > get_time_us(sim))
+        {
+            struct timespec deadline;
+            deadline.tv_sec = sim->start_time.tv_sec + t->due_us / 1000000;
+            deadline.tv_nsec = sim->start_time.tv_nsec + (t->due_us % 1000000) * 1000;
+            if (deadline.tv_nsec >= 1000000000)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
             }
-            pthread_mutex_unlock(&unit_mutex);
-            usleep(10000);  // Minimal sleep to avoid pure busy-wait
+            pthread_cond_timedwait(&sim->pool_cond, &sim->pool_mutex, &deadline);
+            continue;
         }
 
-        pthread_mutex_lock(&output_mutex);
-        printf("Unit %d has completed document recreation phase at time %lld\n",
-                   op->unit_id + 1, get_time_ms() / 1000);
-        fflush(stdout);
-        pthread_mutex_unlock(&output_mutex);
+        sim->pool_timers.pop();
+        pthread_mutex_unlock(&sim->pool_mutex);
+        t->run(t);
+        pthread_mutex_lock(&sim->pool_mutex);
+    }
+    pthread_mutex_unlock(&sim->pool_mutex);
+    return NULL;
+}
+
+/*
+ * Discrete-event driver for virtual mode. Runs on the calling thread: pop the
+ * earliest task, jump the clock to its due time and run it. Tasks never sleep,
+ * so a scenario spanning hours of simulated time finishes in milliseconds,
+ * and ties are broken by scheduling order so the run is repeatable.
+ */
+void run_virtual_clock(Simulation *sim)
+{
+    while (sim->pool_live > 0 && !sim->pool_timers.empty())
+    {
+        Task *t = sim->pool_timers.top();
+        sim->pool_timers.pop();
+        sim->sim_clock_us = t->due_us;
+        t->run(t);
+    }
+}
+
+void pool_op_finish_typing(Task *t);
+void pool_leader_finish_write(Task *t);
+void pool_staff_arrive(Task *t);
+void pool_staff_finish_read(Task *t);
+
+void pool_op_start_typing(Operative *op, int queued)
+{
+    Simulation *sim = op->task.sim;
+    StationSet *stations = &sim->stations;
+    long long wait = get_time_us(sim) - op->task.wait_start_us;
+
+    op->typing_start_us = get_time_us(sim);
+    if (stations->dispatch == DISPATCH_SHARED)
+    {
+        // The wait happened in the shared queue, not at the station
+        resource_acquired(&stations->shared_stats, wait, queued);
+        queued = 0;
+    }
+    resource_acquired(&stations->stats[op->station_id], wait, queued);
+    sim_event(sim, EV_TYPING_STARTED, op->id, op->station_id + 1);
 
-        sem_wait(&write_sem);
+    op->task.run = pool_op_finish_typing;
+    pool_schedule(&op->task, sim->x * 100000LL);
+}
 
-        pthread_mutex_lock(&output_mutex);
-        printf("Unit %d leader (Operative %d) accessing logbook at time %lld\n",
-                   op->unit_id + 1, op->id, get_time_ms() / 1000);
-        fflush(stdout);
-        pthread_mutex_unlock(&output_mutex);
+void pool_op_arrive(Task *t)
+{
+    Operative *op = (Operative *)t;
+    Simulation *sim = t->sim;
+    StationSet *stations = &sim->stations;
 
-        usleep(y * 1000000);
-        completed_operations++;
+    sim_event(sim, EV_OPERATIVE_ARRIVED, op->id);
+    note_arrival(op);
+    t->wait_start_us = get_time_us(sim);
 
-        pthread_mutex_lock(&output_mutex);
-        printf("Unit %d has completed intelligence distribution at time %lld\n",
-                   op->unit_id + 1, get_time_ms() / 1000);
-        fflush(stdout);
-        pthread_mutex_unlock(&output_mutex);
+    if (stations->dispatch == DISPATCH_SHARED)
+    {
+        pthread_mutex_lock(&stations->pick_lock);
+        op->station_id = station_pick_free(stations, op->home_station);
+        if (op->station_id < 0)
+        {
+            resource_enqueue(&stations->shared_stats);
+            queue_push_admit(sim, &sim->pool_shared_waiting, &stations->waiters[stations->count], op);
+            pthread_mutex_unlock(&stations->pick_lock);
+            return;
+        }
+        pthread_mutex_unlock(&stations->pick_lock);
 
-        sem_post(&write_sem);
+        pool_op_start_typing(op, 0);
+        return;
     }
 
-    return NULL;
+    if (stations->dispatch == DISPATCH_JSQ)
+        op->station_id = station_pick_jsq(stations, op->home_station);
+    else
+        op->station_id = op->home_station;
+
+    PoolStation *st = &sim->pool_stations[op->station_id];
+    pthread_mutex_lock(&stations->locks[op->station_id]);
+    if (st->busy == stations->capacity)
+    {
+        resource_enqueue(&stations->stats[op->station_id]);
+        queue_push_admit(sim, &st->waiting, &stations->waiters[op->station_id], op);
+        pthread_mutex_unlock(&stations->locks[op->station_id]);
+        return;
+    }
+    st->busy++;
+    pthread_mutex_unlock(&stations->locks[op->station_id]);
+
+    pool_op_start_typing(op, 0);
 }
 
-int main(int argc, char *argv[])
+void pool_leader_write(Operative *op)
+{
+    Simulation *sim = op->task.sim;
+
+    sim->logbook.write_start_us = get_time_us(sim);
+    sim_event(sim, EV_LEADER_LOGBOOK, op->unit_id + 1, op->id, op->unit);
+
+    op->task.run = pool_leader_finish_write;
+    pool_schedule(&op->task, sim->y * 1000000LL);
+}
+
+void pool_leader_enter_logbook(Operative *op)
 {
-    if (argc != 3)
+    Simulation *sim = op->task.sim;
+
+    sim_event(sim, EV_UNIT_TYPING_DONE, op->unit_id + 1, 0, op->unit);
+
+    pthread_mutex_lock(&sim->pool_logbook_mutex);
+    // Seqlock readers never hold writers off
+    if (sim->pool_writer || (sim->pool_readers > 0 && sim->logbook.policy != LOGBOOK_SEQLOCK))
     {
-        printf("Usage: %s <input_file> <output_file>\n", argv[0]);
-        return 1;
+        op->task.wait_start_us = get_time_us(sim);
+        logbook_note_write_queued(&sim->logbook);
+        queue_push(&sim->pool_waiting_writers, &op->task);
+        pthread_mutex_unlock(&sim->pool_logbook_mutex);
+        return;
     }
+    sim->pool_writer = 1;
+    pthread_mutex_unlock(&sim->pool_logbook_mutex);
 
-    FILE *input_file = fopen(argv[1], "r");
-    FILE *output_file = fopen(argv[2], "w");
+    logbook_note_write(&sim->logbook, 0, 0);
+    pool_leader_write(op);
+}
 
-    if (!input_file || !output_file)
+void pool_op_finish_typing(Task *t)
+{
+    Operative *op = (Operative *)t;
+    Simulation *sim = t->sim;
+    StationSet *stations = &sim->stations;
+    PoolStation *st = &sim->pool_stations[op->station_id];
+
+    sim_event(sim, EV_TYPING_DONE, op->id);
+    long long held = get_time_us(sim) - op->typing_start_us;
+    resource_released(&stations->stats[op->station_id], held);
+
+    int unit_done = unit_latch_count_down(op->unit);
+    rekey_unit(op, ADMIT_FEWEST_LEFT);
+
+    // Hand the seat straight to the next operative queued for it
+    Task *next;
+    if (stations->dispatch == DISPATCH_SHARED)
     {
-        printf("Error opening files\n");
-        return 1;
+        resource_released(&stations->shared_stats, held);
+        pthread_mutex_lock(&stations->pick_lock);
+        next = queue_pop_admit(sim, &sim->pool_shared_waiting, &stations->waiters[stations->count]);
+        if (next)
+            ((Operative *)next)->station_id = op->station_id;
+        else
+            stations->load[op->station_id]--;
+        pthread_mutex_unlock(&stations->pick_lock);
     }
-    fscanf(input_file, "%d %d", &N, &M);
-    fscanf(input_file, "%d %d", &x, &y);
-    fclose(input_file);
+    else
+    {
+        pthread_mutex_lock(&stations->locks[op->station_id]);
+        next = queue_pop_admit(sim, &st->waiting, &stations->waiters[op->station_id]);
+        if (!next)
+            st->busy--;
+        pthread_mutex_unlock(&stations->locks[op->station_id]);
+        if (stations->dispatch == DISPATCH_JSQ)
+            __atomic_sub_fetch(&stations->load[op->station_id], 1, __ATOMIC_RELAXED);
+    }
+    if (next)
+        pool_op_start_typing((Operative *)next, 1);
 
-    dup2(fileno(output_file), STDOUT_FILENO);
-    srand(time(NULL));
-    init_timing();
-    init_sync();
+    // The leader goes on to the logbook once its unit is done and is freed
+    // after the write, possibly on another worker before this returns; any
+    // other member is finished here
+    if (op->is_leader)
+    {
+        if (unit_done)
+            pool_leader_enter_logbook(op);
+        return;
+    }
+    if (unit_done)
+        pool_leader_enter_logbook(op->unit->leader);
+    operative_done(op);
+    pool_task_done(sim);
+}
+
+void pool_staff_read(StaffTask *s)
+{
+    Simulation *sim = s->task.sim;
 
-    Operative operatives[N];
-    pthread_t operative_threads[N];
+    sim_event(sim, EV_STAFF_REVIEW, s->staff_id,
+              logbook_read_value(&sim->logbook, &sim->completed_operations));
 
-    for (int i = 0; i < N; i++)
+    s->task.run = pool_staff_finish_read;
+    pool_schedule(&s->task, (generate_poisson(&s->rng, 1.5) + 1) * 1000000LL);
+}
+
+void pool_leader_finish_write(Task *t)
+{
+    Operative *op = (Operative *)t;
+    Simulation *sim = t->sim;
+    Logbook *logbook = &sim->logbook;
+
+    logbook_write_value(logbook, &sim->completed_operations, sim->completed_operations + 1);
+    logbook_note_write_done(logbook, get_time_us(sim) - logbook->write_start_us);
+
+    sim_event(sim, EV_UNIT_LOGGED, op->unit_id + 1);
+    note_unit_logged(op);
+
+    // Reader-preferring and phase-fair let parked readers in first,
+    // writer-preferring hands over to the next writer if there is one
+    Task *readers = NULL;
+    Task *writer = NULL;
+    pthread_mutex_lock(&sim->pool_logbook_mutex);
+    sim->pool_writer = 0;
+    if (logbook->policy == LOGBOOK_WRITER_PREF || logbook->policy == LOGBOOK_SEQLOCK)
+        writer = queue_pop(&sim->pool_waiting_writers);
+    if (writer)
+    {
+        sim->pool_writer = 1;
+    }
+    else if (sim->pool_waiting_readers.head)
     {
-        operatives[i].id = i + 1;
-        operatives[i].unit_id = i / M;
-        operatives[i].is_leader = ((i + 1) % M == 0) ? 1 : 0;
-        operatives[i].station_id = (i + 1) % 4;
-        if (operatives[i].station_id == 0)
-            operatives[i].station_id = 4;
-        operatives[i].station_id--;
+        readers = sim->pool_waiting_readers.head;
+        for (Task *r = readers; r; r = r->next)
+            sim->pool_readers++;
+        sim->pool_waiting_readers.head = sim->pool_waiting_readers.tail = NULL;
     }
+    else if ((writer = queue_pop(&sim->pool_waiting_writers)))
+    {
+        sim->pool_writer = 1;
+    }
+    pthread_mutex_unlock(&sim->pool_logbook_mutex);
 
-    pthread_t staff_threads[2];
-    int staff_ids[2] = {1, 2};
+    long long now = get_time_us(sim);
+    while (readers)
+    {
+        Task *r = readers;
+        readers = r->next;
+        logbook_note_read(logbook, now - r->wait_start_us);
+        pool_staff_read((StaffTask *)r);
+    }
+    if (writer)
+    {
+        logbook_note_write(logbook, now - writer->wait_start_us, 1);
+        pool_leader_write((Operative *)writer);
+    }
 
-    for (int i = 0; i < 2; i++)
+    operative_done(op);
+    pool_task_done(sim);
+}
+
+void pool_staff_arrive(Task *t)
+{
+    StaffTask *s = (StaffTask *)t;
+    Simulation *sim = t->sim;
+
+    pthread_mutex_lock(&sim->pool_logbook_mutex);
+    int blocked = 0;
+    switch (sim->logbook.policy)
+    {
+    case LOGBOOK_READER_PREF:
+        blocked = sim->pool_writer;
+        break;
+    case LOGBOOK_WRITER_PREF:
+    case LOGBOOK_PHASE_FAIR:
+        blocked = sim->pool_writer || sim->pool_waiting_writers.head != NULL;
+        break;
+    case LOGBOOK_SEQLOCK:
+        blocked = 0;
+        break;
+    }
+    if (blocked)
+    {
+        t->wait_start_us = get_time_us(sim);
+        queue_push(&sim->pool_waiting_readers, t);
+        pthread_mutex_unlock(&sim->pool_logbook_mutex);
+        return;
+    }
+    sim->pool_readers++;
+    pthread_mutex_unlock(&sim->pool_logbook_mutex);
+
+    logbook_note_read(&sim->logbook, 0);
+    pool_staff_read(s);
+}
+
+void pool_staff_finish_read(Task *t)
+{
+    StaffTask *s = (StaffTask *)t;
+    Simulation *sim = t->sim;
+    Task *writer = NULL;
+
+    // Read the count while the read is still held, not racing a writer
+    int completed = logbook_read_value(&sim->logbook, &sim->completed_operations);
+    sim_mark(sim, TL_STAFF_REVIEW_DONE, s->staff_id);
+    pthread_mutex_lock(&sim->pool_logbook_mutex);
+    sim->pool_readers--;
+    if (sim->pool_readers == 0 && !sim->pool_writer && (writer = queue_pop(&sim->pool_waiting_writers)))
+        sim->pool_writer = 1;
+    pthread_mutex_unlock(&sim->pool_logbook_mutex);
+    if (writer)
     {
-        pthread_create(&staff_threads[i], NULL, staff_reader_thread, &staff_ids[i]);
+        logbook_note_write(&sim->logbook, get_time_us(sim) - writer->wait_start_us, 1);
+        pool_leader_write((Operative *)writer);
     }
 
-    for (int i = 0; i < N; i++)
+    if (all_units_logged(sim, completed))
     {
-        pthread_create(&operative_threads[i], NULL, operative_thread, &operatives[i]);
+        return;
     }
+    s->task.run = pool_staff_arrive;
+    pool_schedule(t, (generate_poisson(&s->rng, s->read_interval) + 1) * 1000000LL);
+}
 
-    for (int i = 0; i < N; i++)
+// The injector counts as a live task until the source runs out
+void pool_schedule_arrival(ArrivalTask *a)
+{
+    Simulation *sim = a->task.sim;
+    long long at_us;
+    if (next_arrival(sim, &at_us) != 0)
     {
-        pthread_join(operative_threads[i], NULL);
+        arrivals_end(sim);
+        pool_task_done(sim);
+        return;
     }
+    long long delay = at_us - get_time_us(sim);
+    pool_schedule(&a->task, delay > 0 ? delay : 0);
+}
 
-    sleep(2);
+void pool_inject(Task *t)
+{
+    ArrivalTask *a = (ArrivalTask *)t;
+    Simulation *sim = t->sim;
+    Operative *op = operative_create(sim);
+
+    pthread_mutex_lock(&sim->pool_mutex);
+    sim->pool_live++;
+    pthread_mutex_unlock(&sim->pool_mutex);
+    op->task.run = pool_op_arrive;
+    pool_op_arrive(&op->task);
+    pool_schedule_arrival(a);
+}
 
+void init_staff(Simulation *sim, StaffTask staff[2])
+{
     for (int i = 0; i < 2; i++)
     {
-        pthread_cancel(staff_threads[i]);
+        staff[i].task.sim = sim;
+        staff[i].staff_id = i + 1;
+        staff[i].read_interval = staff[i].staff_id == 1 ? 2.8 : 3.5;
+        sim_rng_init_seeded(&staff[i].rng, sim->seed, sim->N + staff[i].staff_id);
     }
+}
 
-    cleanup_sync();
-    fclose(output_file);
+void run_pool(Simulation *sim)
+{
+    int workers_count = sim->pool_workers;
+    if (workers_count <= 0)
+        workers_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers_count <= 0)
+        workers_count = 1;
 
-    return 0;
-}
\ No newline at end of file
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sim->pool_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&sim->pool_mutex, NULL);
+    pthread_mutex_init(&sim->pool_logbook_mutex, NULL);
+
+    sim->pool_stations = (PoolStation *)malloc(sim->stations.count * sizeof(PoolStation));
+    for (int i = 0; i < sim->stations.count; i++)
+    {
+        sim->pool_stations[i].busy = 0;
+        sim->pool_stations[i].waiting.head = sim->pool_stations[i].waiting.tail = NULL;
+    }
+
+    StaffTask staff[2];
+    init_staff(sim, staff);
+    for (int i = 0; i < 2; i++)
+    {
+        staff[i].task.run = pool_staff_arrive;
+    }
+
+    // Only operatives (and the injector while arrivals keep coming) keep the
+    // run alive; staff timers still pending when the last unit is logged are
+    // dropped instead of waited out
+    ArrivalTask injector;
+    injector.task.sim = sim;
+    injector.task.run = pool_inject;
+    if (sim->arrivals.kind != ARRIVAL_OPERATIVE)
+    {
+        sim->pool_live = 1;
+        pool_schedule_arrival(&injector);
+    }
+    else
+    {
+        sim->pool_live = sim->N;
+        for (int i = 0; i < sim->N; i++)
+        {
+            Operative *op = operative_create(sim);
+            op->task.run = pool_op_arrive;
+            pool_schedule(&op->task, (generate_poisson(&op->rng, 2.0) + 1) * 1000000LL);
+        }
+        arrivals_end(sim);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        pool_schedule(&staff[i].task, (generate_poisson(&staff[i].rng, staff[i].read_interval) + 1) * 1000000LL);
+    }
+
+    if (sim->use_virtual_clock)
+    {
+        run_virtual_clock(sim);
+    }
+    else
+    {
+        pthread_t *workers = (pthread_t *)malloc(workers_count * sizeof(pthread_t));
+        for (int i = 0; i < workers_count; i++)
+        {
+            pthread_create(&workers[i], NULL, pool_worker, sim);
+        }
+        for (int i = 0; i < workers_count; i++)
+        {
+            pthread_join(workers[i], NULL);
+        }
+        free(workers);
+    }
+
+    free(sim->pool_stations);
+    pthread_mutex_destroy(&sim->pool_logbook_mutex);
+    pthread_mutex_destroy(&sim->pool_mutex);
+    pthread_cond_destroy(&sim->pool_cond);
+}
+
+#if CORO_AVAILABLE
+/*
+ * Coroutine mode
+ *
+ * Operatives and staff are coroutines written like the thread-mode functions,
+ * with every sleep and blocking wait replaced by a co_await on the executor
+ * (coro_executor.h). A waiting operative is a parked frame of a few hundred
+ * bytes, so N can run into the millions on a handful of workers. Stations
+ * follow the dispatch policy with FIFO admission, the logbook is reader- or
+ * writer-preferring; main() rejects other admission orders and logbook
+ * policies with --coro.
+ */
+
+typedef struct
+{
+    CoroExecutor executor;
+    CoroSemaphore *seats;       // modulo, jsq: one per station
+    CoroSemaphore shared_slots; // shared: free seats over all stations
+    CoroRWLock logbook;
+} CoroState;
+
+CoroTask coro_operative(Operative *op, CoroState *cs, int injected)
+{
+    Simulation *sim = op->task.sim;
+    StationSet *stations = &sim->stations;
+    CoroExecutor *ex = &cs->executor;
+
+    if (!injected)
+        co_await coro_sleep(ex, (generate_poisson(&op->rng, 2.0) + 1) * 1000000LL);
+    sim_event(sim, EV_OPERATIVE_ARRIVED, op->id);
+    note_arrival(op);
+
+    long long asked = get_time_us(sim);
+    int queued = 0;
+    if (stations->dispatch == DISPATCH_SHARED)
+    {
+        if (!coro_sem_try_acquire(&cs->shared_slots))
+        {
+            resource_enqueue(&stations->shared_stats);
+            co_await coro_sem_acquire(&cs->shared_slots);
+            queued = 1;
+        }
+        pthread_mutex_lock(&stations->pick_lock);
+        op->station_id = station_pick_free(stations, op->home_station);
+        pthread_mutex_unlock(&stations->pick_lock);
+        resource_acquired(&stations->shared_stats, get_time_us(sim) - asked, queued);
+        queued = 0;
+    }
+    else
+    {
+        if (stations->dispatch == DISPATCH_JSQ)
+            op->station_id = station_pick_jsq(stations, op->home_station);
+        else
+            op->station_id = op->home_station;
+        if (!coro_sem_try_acquire(&cs->seats[op->station_id]))
+        {
+            resource_enqueue(&stations->stats[op->station_id]);
+            co_await coro_sem_acquire(&cs->seats[op->station_id]);
+            queued = 1;
+        }
+    }
+    op->typing_start_us = get_time_us(sim);
+    resource_acquired(&stations->stats[op->station_id], op->typing_start_us - asked, queued);
+    sim_event(sim, EV_TYPING_STARTED, op->id, op->station_id + 1);
+
+    co_await coro_sleep(ex, sim->x * 100000LL);
+
+    sim_event(sim, EV_TYPING_DONE, op->id);
+    long long held = get_time_us(sim) - op->typing_start_us;
+    resource_released(&stations->stats[op->station_id], held);
+    if (stations->dispatch == DISPATCH_SHARED)
+    {
+        resource_released(&stations->shared_stats, held);
+        pthread_mutex_lock(&stations->pick_lock);
+        stations->load[op->station_id]--;
+        pthread_mutex_unlock(&stations->pick_lock);
+        coro_sem_release(&cs->shared_slots);
+    }
+    else
+    {
+        coro_sem_release(&cs->seats[op->station_id]);
+        if (stations->dispatch == DISPATCH_JSQ)
+            __atomic_sub_fetch(&stations->load[op->station_id], 1, __ATOMIC_RELAXED);
+    }
+
+    CoroLatch *unit = &op->unit->coro;
+    coro_latch_count_down(unit);
+    if (!op->is_leader)
+    {
+        operative_done(op);
+        co_return;
+    }
+
+    co_await coro_latch_wait(unit);
+    sim_event(sim, EV_UNIT_TYPING_DONE, op->unit_id + 1, 0, op->unit);
+
+    Logbook *logbook = &sim->logbook;
+    long long write_asked = get_time_us(sim);
+    int write_queued = 0;
+    co_await coro_rw_write_lock(&cs->logbook, &write_queued);
+    if (write_queued)
+        logbook_note_write_queued(logbook);
+    logbook->write_start_us = get_time_us(sim);
+    logbook_note_write(logbook, logbook->write_start_us - write_asked, write_queued);
+    sim_event(sim, EV_LEADER_LOGBOOK, op->unit_id + 1, op->id, op->unit);
+
+    co_await coro_sleep(ex, sim->y * 1000000LL);
+
+    logbook_write_value(logbook, &sim->completed_operations, sim->completed_operations + 1);
+    logbook_note_write_done(logbook, get_time_us(sim) - logbook->write_start_us);
+    sim_event(sim, EV_UNIT_LOGGED, op->unit_id + 1);
+    note_unit_logged(op);
+    coro_rw_write_unlock(&cs->logbook);
+    operative_done(op);
+}
+
+// Creates and spawns each operative when the arrival source says it arrives
+CoroTask coro_injector(Simulation *sim, CoroState *cs)
+{
+    long long at_us;
+    while (next_arrival(sim, &at_us) == 0)
+    {
+        long long delay = at_us - get_time_us(sim);
+        if (delay > 0)
+            co_await coro_sleep(&cs->executor, delay);
+        coro_spawn(&cs->executor, coro_operative(operative_create(sim), cs, 1));
+    }
+    arrivals_end(sim);
+}
+
+// Spawned as a daemon: the run ends with the last unit, not the staff's next wake
+CoroTask coro_staff(StaffTask *s, CoroState *cs)
+{
+    Simulation *sim = s->task.sim;
+    CoroExecutor *ex = &cs->executor;
+
+    while (1)
+    {
+        co_await coro_sleep(ex, (generate_poisson(&s->rng, s->read_interval) + 1) * 1000000LL);
+
+        long long asked = get_time_us(sim);
+        co_await coro_rw_read_lock(&cs->logbook);
+        logbook_note_read(&sim->logbook, get_time_us(sim) - asked);
+
+        sim_event(sim, EV_STAFF_REVIEW, s->staff_id,
+                  logbook_read_value(&sim->logbook, &sim->completed_operations));
+
+        co_await coro_sleep(ex, (generate_poisson(&s->rng, 1.5) + 1) * 1000000LL);
+
+        // Read the count while the read is still held, not racing a writer
+        int completed = logbook_read_value(&sim->logbook, &sim->completed_operations);
+        sim_mark(sim, TL_STAFF_REVIEW_DONE, s->staff_id);
+        coro_rw_read_unlock(&cs->logbook);
+        if (all_units_logged(sim, completed))
+        {
+            co_return;
+        }
+    }
+}
+
+void run_coro(Simulation *sim)
+{
+    int workers_count = sim->pool_workers;
+    if (workers_count <= 0)
+        workers_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers_count <= 0)
+        workers_count = 1;
+
+    StationSet *stations = &sim->stations;
+    CoroState *cs = new CoroState();
+    coro_executor_init(&cs->executor);
+    sim->coro_executor = &cs->executor;
+    cs->seats = (CoroSemaphore *)malloc(stations->count * sizeof(CoroSemaphore));
+    for (int i = 0; i < stations->count; i++)
+    {
+        coro_sem_init(&cs->seats[i], &cs->executor, stations->capacity);
+    }
+    coro_sem_init(&cs->shared_slots, &cs->executor, stations->count * stations->capacity);
+    coro_rw_init(&cs->logbook, &cs->executor, sim->logbook.policy != LOGBOOK_READER_PREF);
+
+    StaffTask staff[2];
+    init_staff(sim, staff);
+    if (sim->arrivals.kind != ARRIVAL_OPERATIVE)
+    {
+        coro_spawn(&cs->executor, coro_injector(sim, cs));
+    }
+    else
+    {
+        for (int i = 0; i < sim->N; i++)
+        {
+            coro_spawn(&cs->executor, coro_operative(operative_create(sim), cs, 0));
+        }
+        arrivals_end(sim);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        coro_spawn(&cs->executor, coro_staff(&staff[i], cs), 1);
+    }
+
+    coro_run(&cs->executor, workers_count);
+
+    // Staff still parked on the logbook go with it; the executor, which
+    // frees the ones left in timers, goes last
+    coro_rw_destroy(&cs->logbook);
+    for (int i = 0; i < stations->count; i++)
+    {
+        coro_sem_destroy(&cs->seats[i]);
+    }
+    coro_sem_destroy(&cs->shared_slots);
+    free(cs->seats);
+    coro_executor_destroy(&cs->executor);
+    delete cs;
+}
+#endif
+
+void *injected_operative_thread(void *arg)
+{
+    Simulation *sim = ((Operative *)arg)->task.sim;
+    operative_thread(arg);
+
+    pthread_mutex_lock(&sim->shutdown_lock);
+    if (--sim->operatives_left == 0)
+    {
+        pthread_cond_broadcast(&sim->shutdown_cond);
+    }
+    pthread_mutex_unlock(&sim->shutdown_lock);
+    return NULL;
+}
+
+// Create each operative and start its thread, detached, when the arrival
+// source says it arrives, so only operatives that have arrived exist at all;
+// returns once the last one has finished
+void inject_threads(Simulation *sim)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    sim->operatives_left = 0;
+
+    long long at_us;
+    while (next_arrival(sim, &at_us) == 0)
+    {
+        long long delay = at_us - get_time_us(sim);
+        if (delay > 0)
+        {
+            usleep(delay);
+        }
+        Operative *op = operative_create(sim);
+        pthread_mutex_lock(&sim->shutdown_lock);
+        sim->operatives_left++;
+        pthread_mutex_unlock(&sim->shutdown_lock);
+        pthread_t thread;
+        pthread_create(&thread, &attr, injected_operative_thread, op);
+    }
+    pthread_attr_destroy(&attr);
+    arrivals_end(sim);
+
+    pthread_mutex_lock(&sim->shutdown_lock);
+    while (sim->operatives_left > 0)
+    {
+        pthread_cond_wait(&sim->shutdown_cond, &sim->shutdown_lock);
+    }
+    pthread_mutex_unlock(&sim->shutdown_lock);
+}
+
+void run_threads(Simulation *sim)
+{
+    pthread_t staff_threads[2];
+    StaffTask staff[2];
+    init_staff(sim, staff);
+
+    for (int i = 0; i < 2; i++)
+    {
+        pthread_create(&staff_threads[i], NULL, staff_reader_thread, &staff[i]);
+    }
+
+    if (sim->arrivals.kind != ARRIVAL_OPERATIVE)
+    {
+        inject_threads(sim);
+    }
+    else
+    {
+        pthread_t *operative_threads = (pthread_t *)malloc(sim->N * sizeof(pthread_t));
+        for (int i = 0; i < sim->N; i++)
+        {
+            pthread_create(&operative_threads[i], NULL, operative_thread, operative_create(sim));
+        }
+        arrivals_end(sim);
+
+        for (int i = 0; i < sim->N; i++)
+        {
+            pthread_join(operative_threads[i], NULL);
+        }
+        free(operative_threads);
+    }
+
+    // The last unit is logged: wake the staff out of their waits and let
+    // them exit on their own, never in the middle of a logbook read
+    staff_shutdown(sim);
+    for (int i = 0; i < 2; i++)
+    {
+        pthread_join(staff_threads[i], NULL);
+    }
+}
+
+// A source must hand out whole units: a Poisson COUNT or a trace's arrivals
+// a multiple of M, and the trace must open and read as times; 0 if usable
+int check_arrivals(const SimConfig *cfg)
+{
+    if (cfg->arrival_kind == ARRIVAL_POISSON)
+    {
+        if (cfg->arrival_limit > 0 && cfg->arrival_limit % cfg->M != 0)
+        {
+            printf("Poisson arrival count %lld is not a multiple of M = %d\n", cfg->arrival_limit, cfg->M);
+            return -1;
+        }
+        return 0;
+    }
+    if (cfg->arrival_kind != ARRIVAL_TRACE)
+        return 0;
+
+    ArrivalSource trace;
+    if (arrivals_open_trace(&trace, cfg->arrival_trace) != 0)
+    {
+        printf("Error opening arrival trace %s\n", cfg->arrival_trace);
+        return -1;
+    }
+    long long bad_line = 0;
+    long long count = arrivals_remaining(&trace, &bad_line);
+    arrivals_close(&trace);
+    if (count == -2)
+    {
+        printf("Arrival trace %s: line %lld is not a time in microseconds or goes back in time\n",
+               cfg->arrival_trace, bad_line);
+        return -1;
+    }
+    if (count == 0 || count % cfg->M != 0)
+    {
+        printf("Arrival trace %s has %lld arrivals, not a whole number of units of %d\n", cfg->arrival_trace,
+               count, cfg->M);
+        return -1;
+    }
+    return 0;
+}
+
+Simulation *sim_create(const SimConfig *cfg)
+{
+    Simulation *sim = new Simulation();
+
+    sim->N = cfg->N;
+    sim->M = cfg->M;
+    sim->x = cfg->x;
+    sim->y = cfg->y;
+    sim->seed = cfg->seed;
+    sim->log_events = cfg->log_events;
+    sim->use_pool = cfg->use_pool;
+    sim->pool_workers = cfg->pool_workers;
+    sim->use_virtual_clock = cfg->use_virtual_clock;
+    sim->use_coro = cfg->use_coro;
+    sim->admission = cfg->station_admission;
+    sim->sync_backend = cfg->sync_backend;
+    sim->live = live_metrics;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sim->shutdown_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&sim->shutdown_lock, NULL);
+
+    stations_init(&sim->stations, cfg->num_stations, cfg->station_capacity, cfg->station_dispatch,
+                  cfg->sync_backend);
+    if (sim->admission != ADMIT_FIFO)
+        sim->stations.admission = STATION_ADMIT_PRIORITY;
+    logbook_init(&sim->logbook, cfg->logbook_policy);
+
+    // Arrival gaps get the stream after the staff streams
+    if (cfg->arrival_kind == ARRIVAL_POISSON)
+        arrivals_open_poisson(&sim->arrivals, cfg->arrival_rate, cfg->arrival_limit, sim->seed, sim->N + 3);
+    else if (cfg->arrival_kind == ARRIVAL_TRACE)
+        arrivals_open_trace(&sim->arrivals, cfg->arrival_trace);
+    else
+        arrivals_open_operative(&sim->arrivals);
+    return sim;
+}
+
+void sim_run(Simulation *sim)
+{
+    if (sim->live)
+    {
+        live_add(&sim->live->runs_started, 1);
+    }
+
+    init_timing(sim);
+#if CORO_AVAILABLE
+    if (sim->use_coro)
+    {
+        run_coro(sim);
+    }
+    else
+#endif
+    if (sim->use_pool)
+    {
+        run_pool(sim);
+    }
+    else
+    {
+        run_threads(sim);
+    }
+
+    // Pool and coro runs drop staff still reading at the end
+    if (sim->live)
+    {
+        live_add(&sim->live->readers, -sim->live_readers);
+        live_add(&sim->live->runs_finished, 1);
+    }
+}
+
+void sim_destroy(Simulation *sim)
+{
+    stations_destroy(&sim->stations);
+    logbook_destroy(&sim->logbook);
+    arrivals_close(&sim->arrivals);
+    pthread_mutex_destroy(&sim->shutdown_lock);
+    pthread_cond_destroy(&sim->shutdown_cond);
+    delete sim;
+}
+
+/*
+ * Scenario mode: the input file lists one scenario per line, "N M x y [seed]"
+ * ('#' starts a comment), and up to jobs of them run at once, each as its own
+ * Simulation on its own driver thread. The output file gets one CSV row per
+ * scenario in input order, the aggregate goes to stderr.
+ */
+typedef struct
+{
+    SimConfig cfg;
+    long long wall_us;
+    long long units;
+    long long makespan_us;
+    long long mean_us, p50_us, p95_us, p99_us, max_us;
+} Scenario;
+
+typedef struct
+{
+    Scenario *scenarios;
+    int count;
+    int next; // next scenario to claim
+} ScenarioQueue;
+
+void *scenario_driver(void *arg)
+{
+    ScenarioQueue *queue = (ScenarioQueue *)arg;
+    int i;
+
+    while ((i = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED)) < queue->count)
+    {
+        Scenario *sc = &queue->scenarios[i];
+        struct timespec begin, end;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        Simulation *sim = sim_create(&sc->cfg);
+        sim_run(sim);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        sc->wall_us = (end.tv_sec - begin.tv_sec) * 1000000LL + (end.tv_nsec - begin.tv_nsec) / 1000;
+        sc->units = sim->unit_latency.count;
+        sc->makespan_us = sim->last_unit_logged_us;
+        sc->mean_us = sc->units ? sim->unit_latency.sum_us / sc->units : 0;
+        sc->p50_us = hist_percentile(&sim->unit_latency, 50);
+        sc->p95_us = hist_percentile(&sim->unit_latency, 95);
+        sc->p99_us = hist_percentile(&sim->unit_latency, 99);
+        sc->max_us = sim->unit_latency.max_us;
+        sim_destroy(sim);
+    }
+    return NULL;
+}
+
+int run_scenarios(const SimConfig *base, FILE *input, FILE *output, int jobs)
+{
+    std::vector<Scenario> scenarios;
+    char line[256];
+
+    while (fgets(line, sizeof(line), input))
+    {
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+
+        Scenario sc;
+        memset(&sc, 0, sizeof(sc));
+        sc.cfg = *base;
+        sc.cfg.log_events = 0;
+        unsigned long long seed;
+        int fields = sscanf(line, "%d %d %d %d %llu", &sc.cfg.N, &sc.cfg.M, &sc.cfg.x, &sc.cfg.y, &seed);
+        if (fields <= 0)
+            continue;
+        if (fields < 4 || sc.cfg.N <= 0 || sc.cfg.M <= 0 || sc.cfg.N % sc.cfg.M != 0 ||
+            check_arrivals(&sc.cfg) != 0)
+        {
+            printf("Bad scenario: %s", line);
+            return 1;
+        }
+        // Without an explicit seed, scenario i runs with the base seed + i
+        sc.cfg.seed = fields == 5 ? seed : base->seed + scenarios.size();
+        scenarios.push_back(sc);
+    }
+
+    if (jobs <= 0)
+        jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs <= 0)
+        jobs = 1;
+    if (jobs > (int)scenarios.size())
+        jobs = scenarios.size();
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    ScenarioQueue queue = {scenarios.data(), (int)scenarios.size(), 0};
+    std::vector<pthread_t> drivers(jobs);
+    for (int i = 0; i < jobs; i++)
+    {
+        pthread_create(&drivers[i], NULL, scenario_driver, &queue);
+    }
+    for (int i = 0; i < jobs; i++)
+    {
+        pthread_join(drivers[i], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long long wall_us = (end.tv_sec - begin.tv_sec) * 1000000LL + (end.tv_nsec - begin.tv_nsec) / 1000;
+
+    long long total_units = 0;
+    long long total_sim_wall_us = 0;
+    fprintf(output, "scenario,N,M,x,y,seed,wall_us,units,makespan_us,unit_mean_us,unit_p50_us,unit_p95_us,"
+                    "unit_p99_us,unit_max_us\n");
+    for (size_t i = 0; i < scenarios.size(); i++)
+    {
+        Scenario *sc = &scenarios[i];
+        fprintf(output, "%zu,%d,%d,%d,%d,%llu,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld\n", i + 1, sc->cfg.N,
+                sc->cfg.M, sc->cfg.x, sc->cfg.y, (unsigned long long)sc->cfg.seed, sc->wall_us, sc->units,
+                sc->makespan_us, sc->mean_us, sc->p50_us, sc->p95_us, sc->p99_us, sc->max_us);
+        total_units += sc->units;
+        total_sim_wall_us += sc->wall_us;
+    }
+
+    fprintf(stderr, "Scenarios: %zu on %d jobs in %.3f s (%.2fx parallel), %lld units, %.1f units/s\n",
+            scenarios.size(), jobs, wall_us / 1e6, wall_us > 0 ? (double)total_sim_wall_us / wall_us : 0.0,
+            total_units, wall_us > 0 ? total_units / (wall_us / 1e6) : 0.0);
+    return 0;
+}
+
+// Segment every run adds its counters to while simtop watches; 0 if usable
+int start_live(const char *name)
+{
+    if (!name)
+        return 0;
+    live_metrics = live_open(name);
+    if (!live_metrics)
+    {
+        printf("Error creating live metrics segment %s\n", name);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        printf("Usage: %s <input_file> <output_file> [--pool] [--workers K] [--virtual] [--coro] [--trace FILE]\n"
+               "       [--timeline FILE] [--live NAME]\n"
+               "       [--logbook reader|writer|phase-fair|seqlock] [--metrics table|json|csv]\n"
+               "       [--stations S] [--capacity C] [--dispatch modulo|jsq|shared]\n"
+               "       [--admission fifo|fewest-left|earliest-unit] [--sync posix|std|futex]\n"
+               "       [--arrivals operative|poisson:RATE[:COUNT]|trace:FILE]\n"
+               "       [--seed S] [--draws FILE] [--scenarios [--jobs K]]\n", argv[0]);
+        return 1;
+    }
+
+    SimConfig cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.log_events = 1;
+    cfg.num_stations = 4;
+    cfg.station_capacity = 1;
+    cfg.station_dispatch = DISPATCH_MODULO;
+    cfg.logbook_policy = LOGBOOK_READER_PREF;
+
+    const char *trace_path = NULL;
+    const char *draws_path = NULL;
+    const char *timeline_path = NULL;
+    const char *live_name = NULL;
+    int seeded = 0;
+    int scenario_mode = 0;
+    int jobs = 0;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--pool") == 0)
+        {
+            cfg.use_pool = 1;
+        }
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+        {
+            cfg.pool_workers = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--virtual") == 0)
+        {
+            cfg.use_pool = 1;
+            cfg.use_virtual_clock = 1;
+        }
+        else if (strcmp(argv[i], "--coro") == 0)
+        {
+            if (!CORO_AVAILABLE)
+            {
+                printf("--coro needs a build with -std=c++20\n");
+                return 1;
+            }
+            cfg.use_coro = 1;
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            trace_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--live") == 0 && i + 1 < argc)
+        {
+            live_name = argv[++i];
+        }
+        else if (strcmp(argv[i], "--timeline") == 0 && i + 1 < argc)
+        {
+            timeline_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--logbook") == 0 && i + 1 < argc)
+        {
+            cfg.logbook_policy = logbook_parse_policy(argv[++i]);
+            if (cfg.logbook_policy < 0)
+            {
+                printf("Unknown logbook policy %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "json") == 0)
+                metrics_format = METRICS_JSON;
+            else if (strcmp(argv[i], "csv") == 0)
+                metrics_format = METRICS_CSV;
+            else
+                metrics_format = METRICS_TABLE;
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            uint64_t seed;
+            if (sim_random_parse_seed(argv[++i], &seed) != 0)
+            {
+                printf("Invalid seed %s\n", argv[i]);
+                return 1;
+            }
+            sim_random_seed(seed);
+            seeded = 1;
+        }
+        else if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc)
+        {
+            draws_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--stations") == 0 && i + 1 < argc)
+        {
+            cfg.num_stations = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc)
+        {
+            cfg.station_capacity = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--dispatch") == 0 && i + 1 < argc)
+        {
+            cfg.station_dispatch = station_parse_dispatch(argv[++i]);
+            if (cfg.station_dispatch < 0)
+            {
+                printf("Unknown dispatch policy %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--arrivals") == 0 && i + 1 < argc)
+        {
+            if (arrivals_parse(argv[++i], &cfg.arrival_kind, &cfg.arrival_rate, &cfg.arrival_limit,
+                               &cfg.arrival_trace) != 0)
+            {
+                printf("Bad arrival source %s (operative, poisson:RATE[:COUNT] or trace:FILE)\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--sync") == 0 && i + 1 < argc)
+        {
+            cfg.sync_backend = sync_parse_backend(argv[++i]);
+            if (cfg.sync_backend < 0)
+            {
+                printf("Unknown or unavailable sync backend %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--admission") == 0 && i + 1 < argc)
+        {
+            i++;
+            cfg.station_admission = -1;
+            for (int a = 0; a < 3; a++)
+            {
+                if (strcmp(argv[i], admission_names[a]) == 0)
+                    cfg.station_admission = a;
+            }
+            if (cfg.station_admission < 0)
+            {
+                printf("Unknown admission order %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--scenarios") == 0)
+        {
+            scenario_mode = 1;
+        }
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+        {
+            jobs = atoi(argv[++i]);
+        }
+        else
+        {
+            printf("Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    FILE *input_file = fopen(argv[1], "r");
+    FILE *output_file = fopen(argv[2], "w");
+
+    if (!input_file || !output_file)
+    {
+        printf("Error opening files\n");
+        return 1;
+    }
+    if (cfg.num_stations <= 0 || cfg.station_capacity <= 0)
+    {
+        printf("Station count and capacity must be positive\n");
+        return 1;
+    }
+    if (cfg.use_coro && cfg.use_pool)
+    {
+        printf("--coro cannot be combined with --pool or --virtual\n");
+        return 1;
+    }
+    // Coroutine seats are FIFO and the coroutine logbook is only reader- or
+    // writer-preferring
+    if (cfg.use_coro && cfg.station_admission != ADMIT_FIFO)
+    {
+        printf("--coro supports only --admission fifo\n");
+        return 1;
+    }
+    if (cfg.use_coro && cfg.logbook_policy != LOGBOOK_READER_PREF && cfg.logbook_policy != LOGBOOK_WRITER_PREF)
+    {
+        printf("--coro supports only --logbook reader or writer\n");
+        return 1;
+    }
+
+    // Every delay is drawn from streams derived from this seed
+    if (!seeded)
+        sim_random_seed_randomly();
+    cfg.seed = sim_seed;
+
+    if (scenario_mode)
+    {
+        if (trace_path || draws_path || timeline_path)
+        {
+            printf("--trace, --timeline and --draws need a single run\n");
+            return 1;
+        }
+        if (cfg.arrival_kind == ARRIVAL_POISSON && cfg.arrival_limit < 0)
+        {
+            printf("--scenarios needs a Poisson source with a COUNT\n");
+            return 1;
+        }
+        if (start_live(live_name) != 0)
+        {
+            return 1;
+        }
+        int status = run_scenarios(&cfg, input_file, output_file, jobs);
+        if (live_metrics)
+            live_close(live_metrics, live_name);
+        fclose(input_file);
+        fclose(output_file);
+        return status;
+    }
+
+    fscanf(input_file, "%d %d", &cfg.N, &cfg.M);
+    fscanf(input_file, "%d %d", &cfg.x, &cfg.y);
+    fclose(input_file);
+
+    if (cfg.N <= 0 || cfg.M <= 0 || cfg.N % cfg.M != 0)
+    {
+        printf("N must be a positive multiple of M\n");
+        return 1;
+    }
+    if (check_arrivals(&cfg) != 0)
+    {
+        return 1;
+    }
+
+    // With --trace, events go to a binary trace instead (see trace_format.cpp)
+    if (trace_path && event_log_open(trace_path) != 0)
+    {
+        printf("Error opening trace file %s\n", trace_path);
+        return 1;
+    }
+    if (draws_path && sim_random_record(draws_path) != 0)
+    {
+        printf("Error opening draws file %s\n", draws_path);
+        return 1;
+    }
+
+    if (start_live(live_name) != 0)
+    {
+        return 1;
+    }
+
+    dup2(fileno(output_file), STDOUT_FILENO);
+
+    // With a source, Ctrl-C ends arrivals instead of the process, so the
+    // units under way finish and the metrics still get reported
+    if (cfg.arrival_kind != ARRIVAL_OPERATIVE)
+    {
+        struct sigaction stop;
+        memset(&stop, 0, sizeof(stop));
+        stop.sa_handler = request_arrivals_stop;
+        sigemptyset(&stop.sa_mask);
+        sigaction(SIGINT, &stop, NULL);
+        sigaction(SIGTERM, &stop, NULL);
+    }
+
+    Simulation *sim = sim_create(&cfg);
+    Timeline timeline;
+    if (timeline_path)
+    {
+        timeline_init(&timeline);
+        sim->timeline = &timeline;
+    }
+    sim_run(sim);
+
+    // Spans are paired up and written once the run is over
+    if (timeline_path)
+    {
+        if (timeline_write(&timeline, timeline_path, sim->operatives_started, sim->M, 2) != 0)
+            fprintf(stderr, "Error writing timeline %s\n", timeline_path);
+        else if (metrics_format != METRICS_CSV)
+            fprintf(stderr, "Timeline: %llu events to %s\n", timeline.next - timeline.dropped, timeline_path);
+        timeline_destroy(&timeline);
+    }
+
+    // Metrics go to stderr, the output file only holds the event log
+    if (metrics_format != METRICS_CSV)
+        sim_random_report(stderr);
+    print_metrics(sim, stderr);
+    sim_random_close();
+
+    event_log_close();
+    sim_destroy(sim);
+    if (live_metrics)
+        live_close(live_metrics, live_name);
+    fclose(output_file);
+
+    return 0;
+}
@@ -0,0 +1,7 @@
+#!/bin/bash
+
+# Sweep the simulation over a grid of inputs and modes, one CSV row per run.
+# Options go to sim_bench (see ../sim_bench.cpp), e.g. ./bench.sh --n 64,256 --mode pool,virtual
+g++ -O2 -pthread 2105110.cpp -o sim
+g++ -O2 ../sim_bench.cpp -o sim_bench
+./sim_bench --sim ./sim --out bench.csv "$@"
\ No newline at end of file
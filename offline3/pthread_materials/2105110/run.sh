@@ -1,4 +1,4 @@
 #!/bin/bash
 
-g++ 2105110.cpp
-./a.out input.txt output.txt
\ No newline at end of file
+g++ -pthread 2105110.cpp
+./a.out input.txt output.txt "$@"
\ No newline at end of file
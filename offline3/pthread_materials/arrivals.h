@@ -0,0 +1,217 @@
+/*
+  Arrival sources for the operative simulation.
+
+  An ArrivalSource hands out arrival times, in microseconds since the start
+  of the run, one operative at a time in ID order:
+
+    operative         - no source: every operative draws its own delay,
+                        Poisson(2) + 1 seconds, as the simulation always did
+    poisson:R[:COUNT] - open-loop Poisson process, R arrivals per second on
+                        average (exponential gaps from a stream of its own),
+                        COUNT arrivals or without end
+    trace:FILE        - replay a recorded arrival pattern to its end
+
+  A trace is a text file with one arrival per line, the time in
+  microseconds since the start, in non-decreasing order; blank lines and
+  lines starting with # are skipped. A line holding anything but a time,
+  or a time earlier than the line before, makes the trace invalid
+  (arrivals_remaining reports the first such line before a run starts).
+  The file is memory-mapped and read front to back, so a trace of millions
+  of arrivals is streamed from the page cache instead of being loaded.
+
+  With a source the simulation creates each operative as its arrival comes
+  up and frees it once done, and the source, not N, decides when arrivals
+  end, so nothing (record, thread, timer, coroutine frame) exists for an
+  operative that has not arrived yet or is finished.
+*/
+
+#ifndef ARRIVALS_H
+#define ARRIVALS_H
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sim_random.h"
+
+enum ArrivalKind { ARRIVAL_OPERATIVE, ARRIVAL_POISSON, ARRIVAL_TRACE };
+
+static const char *arrival_kind_names[] = {"operative", "poisson", "trace"};
+
+typedef struct {
+  int kind;
+  double rate;     // poisson: arrivals per second
+  long long limit; // poisson: arrivals to hand out, -1 for no end
+  long long issued;
+  SimRng rng; // poisson: gap stream
+  long long last_us;
+
+  const char *map; // trace: the mapped file
+  size_t size;
+  size_t pos;
+  long long line; // trace: lines read so far
+} ArrivalSource;
+
+/**
+ * Parse --arrivals: "operative", "poisson:R", "poisson:R:COUNT" or
+ * "trace:FILE". The trace path points into spec.
+ * @param limit Set to COUNT, or -1 for a Poisson source without one.
+ * @return 0 on success, -1 if the spec is malformed.
+ */
+static inline int arrivals_parse(const char *spec, int *kind, double *rate,
+                                 long long *limit, const char **path) {
+  if (strcmp(spec, "operative") == 0) {
+    *kind = ARRIVAL_OPERATIVE;
+    return 0;
+  }
+  if (strncmp(spec, "poisson:", 8) == 0) {
+    char *end;
+    *kind = ARRIVAL_POISSON;
+    *rate = strtod(spec + 8, &end);
+    *limit = -1;
+    if (*end == ':') {
+      const char *count = end + 1;
+      *limit = strtoll(count, &end, 10);
+      if (end == count || *limit <= 0)
+        return -1;
+    }
+    return (*end || *rate <= 0) ? -1 : 0;
+  }
+  if (strncmp(spec, "trace:", 6) == 0 && spec[6]) {
+    *kind = ARRIVAL_TRACE;
+    *path = spec + 6;
+    return 0;
+  }
+  return -1;
+}
+
+static inline void arrivals_open_operative(ArrivalSource *src) {
+  memset(src, 0, sizeof(*src));
+  src->kind = ARRIVAL_OPERATIVE;
+}
+
+// limit: arrivals to hand out, -1 for an endless stream
+static inline void arrivals_open_poisson(ArrivalSource *src, double rate,
+                                         long long limit, uint64_t seed,
+                                         uint32_t stream) {
+  memset(src, 0, sizeof(*src));
+  src->kind = ARRIVAL_POISSON;
+  src->rate = rate;
+  src->limit = limit;
+  sim_rng_init_seeded(&src->rng, seed, stream);
+}
+
+/**
+ * Map a trace file for reading.
+ * @return 0 on success, -1 if it cannot be opened or mapped.
+ */
+static inline int arrivals_open_trace(ArrivalSource *src, const char *path) {
+  memset(src, 0, sizeof(*src));
+  src->kind = ARRIVAL_TRACE;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+  src->size = (size_t)st.st_size;
+  if (src->size > 0) {
+    void *map = mmap(NULL, src->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd);
+      return -1;
+    }
+    madvise(map, src->size, MADV_SEQUENTIAL);
+    src->map = (const char *)map;
+  }
+  close(fd);
+  return 0;
+}
+
+static inline void arrivals_close(ArrivalSource *src) {
+  if (src->map)
+    munmap((void *)src->map, src->size);
+  src->map = NULL;
+}
+
+/**
+ * Next arrival time.
+ * @return 0 with *at_us set, -1 once the source is exhausted, or -2 if
+ *         the trace line just read (src->line) is not a valid time.
+ */
+static inline int arrivals_next(ArrivalSource *src, long long *at_us) {
+  if (src->kind == ARRIVAL_POISSON) {
+    if (src->limit >= 0 && src->issued == src->limit)
+      return -1;
+    src->issued++;
+    std::exponential_distribution<double> gap(src->rate);
+    src->last_us += sim_note_draw(&src->rng, (long long)(gap(src->rng) * 1e6));
+    *at_us = src->last_us;
+    return 0;
+  }
+
+  while (src->pos < src->size) {
+    const char *line = src->map + src->pos;
+    const char *end =
+        (const char *)memchr(line, '\n', src->size - src->pos);
+    size_t len = end ? (size_t)(end - line) : src->size - src->pos;
+    src->pos += len + (end ? 1 : 0);
+    src->line++;
+
+    long long value = 0;
+    size_t i = 0;
+    while (i < len && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r'))
+      i++;
+    if (i == len || line[i] == '#')
+      continue;
+    // Stop at 18 digits: a 19th could overflow value
+    size_t digits = 0;
+    while (i < len && line[i] >= '0' && line[i] <= '9') {
+      if (++digits > 18)
+        return -2;
+      value = value * 10 + (line[i++] - '0');
+    }
+    while (i < len && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r'))
+      i++;
+    if (digits == 0 || i < len || value < src->last_us)
+      return -2;
+    src->last_us = value;
+    *at_us = value;
+    return 0;
+  }
+  return -1;
+}
+
+/**
+ * Arrivals left, a trace's counted and validated without consuming them.
+ * @param bad_line Set to the first invalid line's number when -2 is
+ *        returned.
+ * @return The count, -1 for a source without an end, or -2 if a line is
+ *         not a time or goes back in time.
+ */
+static inline long long arrivals_remaining(const ArrivalSource *src,
+                                           long long *bad_line = NULL) {
+  if (src->kind == ARRIVAL_POISSON && src->limit >= 0)
+    return src->limit - src->issued;
+  if (src->kind != ARRIVAL_TRACE)
+    return -1;
+  ArrivalSource copy = *src;
+  long long count = 0, at;
+  int status;
+  while ((status = arrivals_next(&copy, &at)) == 0)
+    count++;
+  if (status == -2) {
+    if (bad_line)
+      *bad_line = copy.line;
+    return -2;
+  }
+  return count;
+}
+
+#endif
@@ -0,0 +1,184 @@
+/*
+  Asynchronous single-writer log for programs whose threads each print
+  whole lines (student_report_printing.cpp).
+
+  Building a line from std::string pieces and writing it under a shared
+  mutex costs a few heap allocations per line and makes every thread queue
+  on the lock and the stream. Here a thread formats its line into a
+  fixed-size record of its own (std::to_chars for numbers, no allocation)
+  and pushes the finished record into an MpmcRing (ring_queue.h). One
+  writer thread pops records as they come and hands them to the kernel
+  with writev, up to LOG_BATCH records per call, so a burst of lines from
+  many threads costs one syscall and no thread ever waits on another's
+  write. If the writer falls behind by a whole ring, producers sleep until
+  it has drained a batch and then all wake together (waking one producer
+  per freed slot would cost a syscall and a context switch per line); no
+  line is dropped.
+
+  Lines keep the order in which their records were pushed. A line longer
+  than a record is cut at LOG_RECORD_SIZE bytes.
+*/
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <charconv>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "ring_queue.h"
+
+#define LOG_RECORD_SIZE 120 // bytes of text per line
+#define LOG_BATCH 1024      // records per writev (IOV_MAX on Linux)
+
+typedef struct {
+  int len; // -1 marks the end of the log
+  char text[LOG_RECORD_SIZE];
+} LogRecord;
+
+typedef struct {
+  int fd;
+  pthread_t writer;
+  MpmcRing<LogRecord> ring;
+  int drained;           // bumped by the writer after a batch, futex word
+  int producers_waiting; // raised by producers that found the ring full
+  unsigned long long lines;      // written by the writer thread
+  unsigned long long writes;     // writev calls
+  unsigned long long full_waits; // producer sleeps on a full ring
+} AsyncLog;
+
+static inline void log_append(LogRecord *r, const char *s) {
+  int n = (int)strlen(s);
+  if (n > LOG_RECORD_SIZE - r->len)
+    n = LOG_RECORD_SIZE - r->len;
+  memcpy(r->text + r->len, s, n);
+  r->len += n;
+}
+
+static inline void log_append(LogRecord *r, long long v) {
+  std::to_chars_result res =
+      std::to_chars(r->text + r->len, r->text + LOG_RECORD_SIZE, v);
+  if (res.ec == std::errc())
+    r->len = (int)(res.ptr - r->text);
+}
+
+static inline void log_append(LogRecord *r, int v) {
+  log_append(r, (long long)v);
+}
+
+// Write iov[0 .. count) in full, resuming after short writes
+static inline int log_writev(int fd, struct iovec *iov, int count) {
+  while (count > 0) {
+    ssize_t n = writev(fd, iov, count);
+    if (n < 0)
+      return -1;
+    while (count > 0 && (size_t)n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = (char *)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return 0;
+}
+
+static void *log_writer(void *arg) {
+  AsyncLog *log = (AsyncLog *)arg;
+  LogRecord *batch = new LogRecord[LOG_BATCH];
+  struct iovec *iov = new struct iovec[LOG_BATCH];
+
+  for (int done = 0; !done;) {
+    // Sleep for the first record, then take whatever else is already queued
+    int count = 0;
+    mpmc_pop(&log->ring, &batch[count++]);
+    while (count < LOG_BATCH && mpmc_try_pop(&log->ring, &batch[count]))
+      count++;
+    if (__atomic_load_n(&log->producers_waiting, __ATOMIC_SEQ_CST) &&
+        __atomic_exchange_n(&log->producers_waiting, 0, __ATOMIC_SEQ_CST)) {
+      __atomic_add_fetch(&log->drained, 1, __ATOMIC_SEQ_CST);
+      futex_wake_all(&log->drained);
+    }
+
+    int lines = 0;
+    for (int i = 0; i < count; i++) {
+      if (batch[i].len < 0) {
+        done = 1; // every line pushed before the end marker is in this batch
+        break;
+      }
+      iov[lines].iov_base = batch[i].text;
+      iov[lines].iov_len = batch[i].len;
+      lines++;
+    }
+    if (lines > 0) {
+      log_writev(log->fd, iov, lines);
+      log->lines += lines;
+      log->writes++;
+    }
+  }
+
+  delete[] iov;
+  delete[] batch;
+  return NULL;
+}
+
+/**
+ * Create (or truncate) path and start the writer thread.
+ * @param capacity Records the ring holds before producers have to wait.
+ * @return 0 on success, -1 if the file cannot be opened.
+ */
+static inline int async_log_open(AsyncLog *log, const char *path,
+                                 unsigned capacity = 4096) {
+  log->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (log->fd < 0)
+    return -1;
+  log->drained = log->producers_waiting = 0;
+  log->lines = log->writes = log->full_waits = 0;
+  mpmc_init(&log->ring, capacity);
+  pthread_create(&log->writer, NULL, log_writer, log);
+  return 0;
+}
+
+// Queue a record, sleeping while the ring is full
+static inline void async_log_push(AsyncLog *log, const LogRecord &r) {
+  while (!mpmc_try_push(&log->ring, r)) {
+    // Announce, then re-check: either the writer sees the flag after its
+    // pops or the retry sees the slots they freed
+    int drained = __atomic_load_n(&log->drained, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&log->producers_waiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (mpmc_try_push(&log->ring, r))
+      break;
+    __atomic_add_fetch(&log->full_waits, 1, __ATOMIC_RELAXED);
+    futex_wait(&log->drained, drained);
+  }
+}
+
+// Format one line from strings and integers and queue it for the writer
+template <typename... Parts>
+static inline void async_log_line(AsyncLog *log, const Parts &...parts) {
+  LogRecord r;
+  r.len = 0;
+  (log_append(&r, parts), ...);
+  async_log_push(log, r);
+}
+
+/**
+ * Write out every line queued so far, stop the writer and close the file.
+ * Lines must not be queued after this starts.
+ */
+static inline void async_log_close(AsyncLog *log) {
+  LogRecord end;
+  end.len = -1;
+  async_log_push(log, end);
+  pthread_join(log->writer, NULL);
+  mpmc_destroy(&log->ring);
+  close(log->fd);
+}
+
+#endif
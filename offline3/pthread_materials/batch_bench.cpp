@@ -0,0 +1,310 @@
+/*
+  Batching benchmark: prod_cons_with_mutex.cpp's queue, one item per lock,
+  against batch_queue.h moving up to K items per lock.
+
+  P producer threads create ITEMS items in total and C consumer threads
+  take them, with no sleeps or printing. Every item is stamped with the
+  time it was created, so the consumer that takes it knows how long it
+  spent in the producer's batch and in the queue. Modes:
+    mutex     - prod_cons_with_mutex.cpp's scheme: std::queue guarded by a
+                pthread mutex, empty/full counting semaphores (sem_t)
+    batch     - BatchQueue with a fixed batch of K: producers gather K
+                items, then bq_push_n; consumers bq_pop_n up to K at a time
+                (one row per K in --batch)
+    adaptive  - BatchQueue with adaptive batching, capped at the largest K:
+                producers gather bq_push_batch() items at a time
+
+  One CSV row per run:
+
+    mode,producers,consumers,capacity,batch,items,rep,wall_s,items_per_s,
+    rounds,items_per_round,lat_p50_us,lat_p99_us,ok,user_s,sys_s,
+    vol_ctx_switches,invol_ctx_switches
+
+  rounds counts lock acquisitions on both sides (2 per item for mutex),
+  items_per_round is the batch actually moved per lock on average, the
+  latencies are percentiles of creation-to-pop time over every item, ok
+  whether the consumers' checksum matched what the producers pushed. CPU
+  time and context switches are getrusage deltas over the run.
+
+  Compilation:
+    g++ -O2 -pthread batch_bench.cpp -o batch_bench
+
+  Usage:
+    ./batch_bench [--mode LIST] [--batch LIST] [--producers LIST]
+                  [--consumers LIST] [--capacity N] [--items N] [--reps K]
+                  [--out FILE]
+
+    LIST is comma separated. Defaults: --mode mutex,batch,adaptive
+    --batch 1,2,4,8,16,32,64 --producers 1,4 --consumers 1,4
+    --capacity 1024 --items 2000000 --reps 1, CSV on stdout.
+*/
+
+#include <algorithm>
+#include <pthread.h>
+#include <queue>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+#include <time.h>
+#include <vector>
+
+#include "batch_queue.h"
+#include "bench_util.h"
+
+enum { MODE_MUTEX, MODE_BATCH, MODE_ADAPTIVE };
+static const char *mode_names[] = {"mutex", "batch", "adaptive"};
+
+typedef struct {
+  int id;
+  long long created_ns;
+} BenchItem;
+
+typedef struct {
+  int mode;
+  int batch; // fixed K, or the adaptive cap
+  // mutex
+  sem_t empty_sem;
+  sem_t full;
+  std::queue<BenchItem> q;
+  pthread_mutex_t lock;
+  // batch, adaptive
+  BatchQueue<BenchItem> bq;
+} BenchQueue;
+
+typedef struct {
+  BenchQueue *queue;
+  long long first, count; // items first .. first + count - 1
+  long long checksum;     // consumers: sum of the ids they popped
+  std::vector<long long> latency_ns;
+} BenchSide;
+
+static void *bench_producer(void *arg) {
+  BenchSide *side = (BenchSide *)arg;
+  BenchQueue *q = side->queue;
+  std::vector<BenchItem> batch(q->batch);
+  long long next = side->first, end = side->first + side->count;
+
+  while (next < end) {
+    if (q->mode == MODE_MUTEX) {
+      BenchItem item = {(int)next++, now_ns()};
+      sem_wait(&q->empty_sem);
+      pthread_mutex_lock(&q->lock);
+      q->q.push(item);
+      pthread_mutex_unlock(&q->lock);
+      sem_post(&q->full);
+      continue;
+    }
+    int k = q->mode == MODE_BATCH ? q->batch : bq_push_batch(&q->bq);
+    if (k > end - next)
+      k = (int)(end - next);
+    for (int i = 0; i < k; i++) {
+      batch[i].id = (int)next++;
+      batch[i].created_ns = now_ns();
+    }
+    bq_push_n(&q->bq, batch.data(), k);
+  }
+  return NULL;
+}
+
+static void *bench_consumer(void *arg) {
+  BenchSide *side = (BenchSide *)arg;
+  BenchQueue *q = side->queue;
+  std::vector<BenchItem> batch(q->batch);
+  long long sum = 0, left = side->count;
+
+  while (left > 0) {
+    int got;
+    if (q->mode == MODE_MUTEX) {
+      sem_wait(&q->full);
+      pthread_mutex_lock(&q->lock);
+      batch[0] = q->q.front();
+      q->q.pop();
+      pthread_mutex_unlock(&q->lock);
+      sem_post(&q->empty_sem);
+      got = 1;
+    } else {
+      got = bq_pop_n(&q->bq, batch.data(),
+                     left < q->batch ? (int)left : q->batch);
+    }
+    long long now = now_ns();
+    for (int i = 0; i < got; i++) {
+      sum += batch[i].id;
+      side->latency_ns.push_back(now - batch[i].created_ns);
+    }
+    left -= got;
+  }
+  side->checksum = sum;
+  return NULL;
+}
+
+// p-th percentile (0..1) of all samples, in microseconds
+static double percentile_us(std::vector<long long> &samples, double p) {
+  if (samples.empty())
+    return 0;
+  size_t k = (size_t)(p * (samples.size() - 1));
+  std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+  return samples[k] / 1e3;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<int> modes = {MODE_MUTEX, MODE_BATCH, MODE_ADAPTIVE};
+  std::vector<int> batches = {1, 2, 4, 8, 16, 32, 64};
+  std::vector<int> producer_counts = {1, 4};
+  std::vector<int> consumer_counts = {1, 4};
+  int capacity = 1024, reps = 1;
+  long long items = 2000000;
+  const char *out_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (strcmp(arg, "--mode") == 0) {
+      modes.clear();
+      std::string name;
+      for (const char *p = value;; p++) {
+        if (*p == ',' || *p == '\0') {
+          int mode = -1;
+          for (int k = 0; k < 3; k++)
+            if (name == mode_names[k])
+              mode = k;
+          if (mode < 0) {
+            fprintf(stderr, "Unknown mode %s\n", name.c_str());
+            return 1;
+          }
+          modes.push_back(mode);
+          name.clear();
+          if (*p == '\0')
+            break;
+        } else {
+          name += *p;
+        }
+      }
+    } else if (strcmp(arg, "--batch") == 0)
+      batches = parse_list(value);
+    else if (strcmp(arg, "--producers") == 0)
+      producer_counts = parse_list(value);
+    else if (strcmp(arg, "--consumers") == 0)
+      consumer_counts = parse_list(value);
+    else if (strcmp(arg, "--capacity") == 0)
+      capacity = atoi(value);
+    else if (strcmp(arg, "--items") == 0)
+      items = atoll(value);
+    else if (strcmp(arg, "--reps") == 0)
+      reps = atoi(value);
+    else if (strcmp(arg, "--out") == 0)
+      out_path = value;
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+  // Item ids are int
+  if (capacity <= 0 || items <= 0 || items > 2147483647 || reps <= 0) {
+    fprintf(stderr, "Capacity, items (up to 2^31 - 1) and reps must be "
+                    "positive\n");
+    return 1;
+  }
+  int batch_cap = 1;
+  for (int k : batches)
+    if (k <= 0) {
+      fprintf(stderr, "Batch sizes must be positive\n");
+      return 1;
+    } else if (k > batch_cap)
+      batch_cap = k;
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Error opening %s\n", out_path);
+    return 1;
+  }
+  fprintf(out, "mode,producers,consumers,capacity,batch,items,rep,wall_s,"
+               "items_per_s,rounds,items_per_round,lat_p50_us,lat_p99_us,ok,"
+               "user_s,sys_s,vol_ctx_switches,invol_ctx_switches\n");
+
+  for (int producers : producer_counts)
+    for (int consumers : consumer_counts) {
+      if (producers <= 0 || consumers <= 0)
+        continue;
+      for (int mode : modes) {
+        // batch runs once per K, the others once
+        std::vector<int> ks = mode == MODE_BATCH ? batches
+                              : mode == MODE_ADAPTIVE
+                                  ? std::vector<int>(1, batch_cap)
+                                  : std::vector<int>(1, 1);
+        for (int k : ks)
+          for (int rep = 0; rep < reps; rep++) {
+            BenchQueue *bq = new BenchQueue();
+            bq->mode = mode;
+            sem_init(&bq->empty_sem, 0, capacity);
+            sem_init(&bq->full, 0, 0);
+            pthread_mutex_init(&bq->lock, NULL);
+            bq_init(&bq->bq, capacity, k, mode == MODE_ADAPTIVE);
+            bq->batch = bq->bq.batch_max; // K clamped to the capacity
+
+            std::vector<BenchSide> prod(producers), cons(consumers);
+            split(prod, bq, items);
+            split(cons, bq, items);
+            for (BenchSide &c : cons)
+              c.latency_ns.reserve(c.count);
+            std::vector<pthread_t> tids(producers + consumers);
+
+            struct rusage before, after;
+            getrusage(RUSAGE_SELF, &before);
+            long long start = now_ns();
+            for (int i = 0; i < consumers; i++)
+              pthread_create(&tids[i], NULL, bench_consumer, &cons[i]);
+            for (int i = 0; i < producers; i++)
+              pthread_create(&tids[consumers + i], NULL, bench_producer,
+                             &prod[i]);
+            for (pthread_t t : tids)
+              pthread_join(t, NULL);
+            double wall = (now_ns() - start) / 1e9;
+            getrusage(RUSAGE_SELF, &after);
+
+            long long checksum = 0;
+            std::vector<long long> latency;
+            latency.reserve(items);
+            for (BenchSide &c : cons) {
+              checksum += c.checksum;
+              latency.insert(latency.end(), c.latency_ns.begin(),
+                             c.latency_ns.end());
+            }
+            unsigned long long rounds =
+                mode == MODE_MUTEX ? 2ULL * items
+                                   : bq->bq.push_rounds + bq->bq.pop_rounds;
+            double p50 = percentile_us(latency, 0.50);
+            double p99 = percentile_us(latency, 0.99);
+
+            fprintf(out,
+                    "%s,%d,%d,%d,%d,%lld,%d,%.6f,%.1f,%llu,%.2f,%.2f,%.2f,",
+                    mode_names[mode], producers, consumers, capacity,
+                    bq->batch, items, rep, wall, items / wall, rounds,
+                    2.0 * items / rounds, p50, p99);
+            fprintf(out, "%d,%.6f,%.6f,%ld,%ld\n",
+                    checksum == items * (items - 1) / 2,
+                    tv_s(after.ru_utime) - tv_s(before.ru_utime),
+                    tv_s(after.ru_stime) - tv_s(before.ru_stime),
+                    after.ru_nvcsw - before.ru_nvcsw,
+                    after.ru_nivcsw - before.ru_nivcsw);
+            fflush(out);
+
+            bq_destroy(&bq->bq);
+            pthread_mutex_destroy(&bq->lock);
+            sem_destroy(&bq->empty_sem);
+            sem_destroy(&bq->full);
+            delete bq;
+          }
+      }
+    }
+
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
@@ -0,0 +1,202 @@
+/*
+  Bounded producer/consumer buffer that moves items in batches.
+
+  prod_cons_with_mutex.cpp moves one item per sem_wait, lock, push/pop,
+  unlock, sem_post. BatchQueue keeps that shape (a mutex around the buffer,
+  an empty-slot count and a full-slot count) but moves up to K items per
+  round: a producer takes up to K free slots from the empty count in one
+  step, copies that many items in under one lock and adds them to the full
+  count in one step, and a consumer does the reverse. sem_t can only move
+  by one, so both counts are BatchSem, a counter with futex waits (futex.h)
+  that takes "up to n" and gives n at once.
+
+  With adaptive batching each side's batch starts at 1 and is retuned
+  under the lock after every round from how many items are queued: it
+  doubles (up to batch_max) while the queue is at least half full, since
+  the other side is behind and items wait anyway, and halves while fewer
+  items are queued than one batch, since the other side keeps up and
+  handing items over sooner is what matters. Without it every round moves
+  up to batch_max.
+*/
+
+#ifndef BATCH_QUEUE_H
+#define BATCH_QUEUE_H
+
+#include <pthread.h>
+
+#include "futex.h"
+
+// Counting semaphore that moves any number of permits per call
+
+typedef struct {
+  alignas(64) int count; // free permits, the futex word
+  int waiters;           // threads parked on count
+  unsigned long long waits; // takes that had to sleep
+} BatchSem;
+
+static inline void bsem_init(BatchSem *s, int value) {
+  s->count = value;
+  s->waiters = 0;
+  s->waits = 0;
+}
+
+/**
+ * Take between 1 and max permits without blocking.
+ * @return How many were taken, 0 if none were free.
+ */
+static inline int bsem_try_take(BatchSem *s, int max) {
+  int c = __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+  while (c > 0) {
+    int n = c < max ? c : max;
+    if (__atomic_compare_exchange_n(&s->count, &c, c - n, 1, __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED))
+      return n;
+  }
+  return 0;
+}
+
+/**
+ * Take between 1 and max permits, sleeping while none are free.
+ * @return How many were taken.
+ */
+static inline int bsem_take(BatchSem *s, int max) {
+  int n = bsem_try_take(s, max);
+  if (n)
+    return n;
+  __atomic_add_fetch(&s->waits, 1, __ATOMIC_RELAXED);
+  // Same handshake as the futex SyncSemaphore: announce, re-check, sleep
+  for (;;) {
+    __atomic_add_fetch(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    n = bsem_try_take(s, max);
+    if (!n)
+      futex_wait(&s->count, 0);
+    __atomic_sub_fetch(&s->waiters, 1, __ATOMIC_RELAXED);
+    if (n || (n = bsem_try_take(s, max)))
+      return n;
+  }
+}
+
+static inline void bsem_give(BatchSem *s, int n) {
+  __atomic_add_fetch(&s->count, n, __ATOMIC_SEQ_CST);
+  // Every woken waiter takes at least one permit, so n wakes are enough
+  if (__atomic_load_n(&s->waiters, __ATOMIC_SEQ_CST) > 0)
+    futex_wake(&s->count, n);
+}
+
+// The queue
+
+template <typename T> struct BatchQueue {
+  BatchSem empty_slots; // producers take, consumers give
+  BatchSem full_slots;  // consumers take, producers give
+
+  alignas(64) pthread_mutex_t lock;
+  T *slots;
+  int capacity;
+  int head;  // next slot to pop
+  int count; // items in the buffer
+  int batch_max;
+  int adaptive;
+  int push_batch; // current batch per side
+  int pop_batch;
+  unsigned long long push_rounds; // lock acquisitions per side
+  unsigned long long pop_rounds;
+};
+
+template <typename T>
+static inline void bq_init(BatchQueue<T> *q, int capacity, int batch_max,
+                           int adaptive) {
+  if (batch_max > capacity)
+    batch_max = capacity;
+  if (batch_max < 1)
+    batch_max = 1;
+  bsem_init(&q->empty_slots, capacity);
+  bsem_init(&q->full_slots, 0);
+  pthread_mutex_init(&q->lock, NULL);
+  q->slots = new T[capacity];
+  q->capacity = capacity;
+  q->head = q->count = 0;
+  q->batch_max = batch_max;
+  q->adaptive = adaptive;
+  q->push_batch = q->pop_batch = adaptive ? 1 : batch_max;
+  q->push_rounds = q->pop_rounds = 0;
+}
+
+template <typename T> static inline void bq_destroy(BatchQueue<T> *q) {
+  pthread_mutex_destroy(&q->lock);
+  delete[] q->slots;
+}
+
+// Retune one side's batch from the queue length (lock held)
+template <typename T> static inline void bq_adapt(BatchQueue<T> *q, int *batch) {
+  if (!q->adaptive)
+    return;
+  if (2 * q->count >= q->capacity)
+    *batch = *batch * 2 < q->batch_max ? *batch * 2 : q->batch_max;
+  else if (q->count < *batch && *batch > 1)
+    *batch /= 2;
+}
+
+/**
+ * How many items a producer should gather before calling bq_push_n, for
+ * producers that build their items in batches themselves.
+ * @return The producers' current batch.
+ */
+template <typename T> static inline int bq_push_batch(BatchQueue<T> *q) {
+  return __atomic_load_n(&q->push_batch, __ATOMIC_RELAXED);
+}
+
+// Push all n items, up to one batch per lock, sleeping while the queue is full
+template <typename T>
+static inline void bq_push_n(BatchQueue<T> *q, const T *items, int n) {
+  while (n > 0) {
+    int want = bq_push_batch(q);
+    int got = bsem_take(&q->empty_slots, n < want ? n : want);
+
+    pthread_mutex_lock(&q->lock);
+    int tail = q->head + q->count;
+    for (int i = 0; i < got; i++)
+      q->slots[(tail + i) % q->capacity] = items[i];
+    q->count += got;
+    q->push_rounds++;
+    bq_adapt(q, &q->push_batch);
+    pthread_mutex_unlock(&q->lock);
+
+    bsem_give(&q->full_slots, got);
+    items += got;
+    n -= got;
+  }
+}
+
+/**
+ * Pop up to max items (and at most one batch) under one lock, sleeping while
+ * the queue is empty.
+ * @return How many were popped into items, at least 1.
+ */
+template <typename T>
+static inline int bq_pop_n(BatchQueue<T> *q, T *items, int max) {
+  int want = __atomic_load_n(&q->pop_batch, __ATOMIC_RELAXED);
+  int got = bsem_take(&q->full_slots, max < want ? max : want);
+
+  pthread_mutex_lock(&q->lock);
+  for (int i = 0; i < got; i++)
+    items[i] = q->slots[(q->head + i) % q->capacity];
+  q->head = (q->head + got) % q->capacity;
+  q->count -= got;
+  q->pop_rounds++;
+  bq_adapt(q, &q->pop_batch);
+  pthread_mutex_unlock(&q->lock);
+
+  bsem_give(&q->empty_slots, got);
+  return got;
+}
+
+template <typename T>
+static inline void bq_push(BatchQueue<T> *q, const T &item) {
+  bq_push_n(q, &item, 1);
+}
+
+template <typename T> static inline void bq_pop(BatchQueue<T> *q, T *item) {
+  bq_pop_n(q, item, 1);
+}
+
+#endif
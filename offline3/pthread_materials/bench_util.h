@@ -0,0 +1,68 @@
+/*
+  Helpers shared by the *_bench.cpp drivers: comma-separated option lists,
+  monotonic timestamps, getrusage times, and handing a run's items out to
+  producer and consumer threads.
+*/
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <vector>
+
+/**
+ * Parse a comma separated list of integers such as "1,2,4".
+ * @return The values in order.
+ */
+static inline std::vector<int> parse_list(const char *text) {
+  std::vector<int> values;
+  const char *p = text;
+  while (*p) {
+    values.push_back(atoi(p));
+    p = strchr(p, ',');
+    if (!p)
+      break;
+    p++;
+  }
+  return values;
+}
+
+static inline long long now_ns() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static inline double now_s() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// A getrusage time in seconds
+static inline double tv_s(struct timeval tv) {
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/**
+ * Split count items over the threads of one side, the first count % n
+ * getting one more. Side needs queue, first, count and checksum fields.
+ */
+template <typename Side, typename Queue>
+static inline void split(std::vector<Side> &sides, Queue *bq,
+                         long long count) {
+  long long first = 0;
+  int n = (int)sides.size();
+  for (int i = 0; i < n; i++) {
+    sides[i].queue = bq;
+    sides[i].first = first;
+    sides[i].count = count / n + (i < count % n ? 1 : 0);
+    sides[i].checksum = 0;
+    first += sides[i].count;
+  }
+}
+
+#endif
@@ -0,0 +1,486 @@
+/*
+  C++20 coroutine executor for the operative simulations.
+
+  A CoroTask is a coroutine that runs until it finishes, suspending at
+  co_await points instead of blocking a thread. coro_run() drives them on a
+  few worker threads: a ready queue of coroutines to resume and a min-heap
+  of timers for coroutines sleeping until a due time. A suspended operative
+  costs its coroutine frame (a few hundred bytes), not a pthread stack, and
+  handing a station seat from one operative to the next is a push onto the
+  ready queue and a resume in user space, not a kernel wake-up.
+
+  Awaitables, all FIFO:
+    coro_sleep(ex, us)            resume after us microseconds
+    CoroSemaphore                 counting semaphore, a release hands the
+                                  permit straight to the oldest waiter
+    CoroLatch                     one-shot count-down, waiters resume at zero
+    CoroRWLock                    reader-writer lock, reader- or writer-
+                                  preferring
+
+  coro_run() returns once every task spawned with coro_spawn() has
+  finished. Daemon tasks (the logbook staff) do not keep it running; any
+  still suspended are destroyed with whatever they wait on: parked on a
+  semaphore, latch or rwlock when that is destroyed, in a timer or the
+  ready queue with the executor. Destroy the awaitables first, the
+  executor last.
+
+  Only available when built with -std=c++20 (CORO_AVAILABLE).
+*/
+
+#ifndef CORO_EXECUTOR_H
+#define CORO_EXECUTOR_H
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define CORO_AVAILABLE 1
+
+#include <coroutine>
+#include <deque>
+#include <pthread.h>
+#include <queue>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+typedef struct CoroExecutor CoroExecutor;
+
+static inline void coro_task_exited(CoroExecutor *ex);
+
+// Starts suspended until spawned, frees its own frame when it returns
+struct CoroTask {
+  struct promise_type {
+    CoroExecutor *executor = nullptr;
+    int daemon = 0;
+
+    CoroTask get_return_object() {
+      return CoroTask{
+          std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { abort(); }
+    ~promise_type() {
+      if (executor && !daemon)
+        coro_task_exited(executor);
+    }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+typedef struct {
+  long long due_us;
+  unsigned long long seq;
+  std::coroutine_handle<> handle;
+} CoroTimer;
+
+struct CoroTimerLater {
+  bool operator()(const CoroTimer &a, const CoroTimer &b) const {
+    if (a.due_us != b.due_us)
+      return a.due_us > b.due_us;
+    return a.seq > b.seq;
+  }
+};
+
+struct CoroExecutor {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  std::deque<std::coroutine_handle<>> ready;
+  std::priority_queue<CoroTimer, std::vector<CoroTimer>, CoroTimerLater>
+      timers;
+  unsigned long long seq;
+  long long live; // spawned, non-daemon tasks not finished yet
+  unsigned long long resumes;
+};
+
+static inline long long coro_now_us() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+static inline void coro_executor_init(CoroExecutor *ex) {
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&ex->cond, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_mutex_init(&ex->lock, NULL);
+  ex->seq = 0;
+  ex->live = 0;
+  ex->resumes = 0;
+}
+
+// Destroys daemon tasks still parked in the timer heap or ready queue
+static inline void coro_executor_destroy(CoroExecutor *ex) {
+  while (!ex->timers.empty()) {
+    ex->timers.top().handle.destroy();
+    ex->timers.pop();
+  }
+  while (!ex->ready.empty()) {
+    ex->ready.front().destroy();
+    ex->ready.pop_front();
+  }
+  pthread_mutex_destroy(&ex->lock);
+  pthread_cond_destroy(&ex->cond);
+}
+
+static inline void coro_task_exited(CoroExecutor *ex) {
+  pthread_mutex_lock(&ex->lock);
+  if (--ex->live == 0)
+    pthread_cond_broadcast(&ex->cond);
+  pthread_mutex_unlock(&ex->lock);
+}
+
+// Queue a suspended coroutine to be resumed by a worker
+static inline void coro_make_ready(CoroExecutor *ex,
+                                   std::coroutine_handle<> h) {
+  pthread_mutex_lock(&ex->lock);
+  ex->ready.push_back(h);
+  pthread_cond_signal(&ex->cond);
+  pthread_mutex_unlock(&ex->lock);
+}
+
+static inline void coro_make_ready_at(CoroExecutor *ex, long long due_us,
+                                      std::coroutine_handle<> h) {
+  pthread_mutex_lock(&ex->lock);
+  ex->timers.push(CoroTimer{due_us, ex->seq++, h});
+  pthread_cond_signal(&ex->cond);
+  pthread_mutex_unlock(&ex->lock);
+}
+
+/**
+ * Hand a task to the executor; it first runs on a worker inside coro_run().
+ * @param daemon 1 if coro_run() should not wait for the task to finish.
+ */
+static inline void coro_spawn(CoroExecutor *ex, CoroTask task,
+                              int daemon = 0) {
+  task.handle.promise().executor = ex;
+  task.handle.promise().daemon = daemon;
+  if (!daemon) {
+    pthread_mutex_lock(&ex->lock);
+    ex->live++;
+    pthread_mutex_unlock(&ex->lock);
+  }
+  coro_make_ready(ex, task.handle);
+}
+
+static inline void *coro_worker(void *arg) {
+  CoroExecutor *ex = (CoroExecutor *)arg;
+
+  pthread_mutex_lock(&ex->lock);
+  while (ex->live > 0) {
+    long long now = coro_now_us();
+    while (!ex->timers.empty() && ex->timers.top().due_us <= now) {
+      ex->ready.push_back(ex->timers.top().handle);
+      ex->timers.pop();
+    }
+
+    if (!ex->ready.empty()) {
+      std::coroutine_handle<> h = ex->ready.front();
+      ex->ready.pop_front();
+      ex->resumes++;
+      pthread_mutex_unlock(&ex->lock);
+      h.resume();
+      pthread_mutex_lock(&ex->lock);
+      continue;
+    }
+
+    if (ex->timers.empty()) {
+      pthread_cond_wait(&ex->cond, &ex->lock);
+      continue;
+    }
+    long long due = ex->timers.top().due_us;
+    struct timespec deadline;
+    deadline.tv_sec = due / 1000000;
+    deadline.tv_nsec = (due % 1000000) * 1000;
+    pthread_cond_timedwait(&ex->cond, &ex->lock, &deadline);
+  }
+  pthread_mutex_unlock(&ex->lock);
+  return NULL;
+}
+
+// Run spawned tasks on the calling thread plus workers - 1 more
+static inline void coro_run(CoroExecutor *ex, int workers) {
+  std::vector<pthread_t> threads(workers > 1 ? workers - 1 : 0);
+  for (pthread_t &t : threads)
+    pthread_create(&t, NULL, coro_worker, ex);
+  coro_worker(ex);
+  for (pthread_t &t : threads)
+    pthread_join(t, NULL);
+}
+
+// Sleep
+
+struct CoroSleep {
+  CoroExecutor *ex;
+  long long delay_us;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> h) {
+    coro_make_ready_at(ex, coro_now_us() + delay_us, h);
+  }
+  void await_resume() const noexcept {}
+};
+
+static inline CoroSleep coro_sleep(CoroExecutor *ex, long long delay_us) {
+  return CoroSleep{ex, delay_us};
+}
+
+// Counting semaphore
+
+typedef struct {
+  CoroExecutor *ex;
+  pthread_mutex_t lock;
+  int count;
+  std::deque<std::coroutine_handle<>> *waiters;
+} CoroSemaphore;
+
+static inline void coro_sem_init(CoroSemaphore *s, CoroExecutor *ex,
+                                 int count) {
+  s->ex = ex;
+  pthread_mutex_init(&s->lock, NULL);
+  s->count = count;
+  s->waiters = new std::deque<std::coroutine_handle<>>();
+}
+
+// Destroys tasks still parked on the semaphore
+static inline void coro_sem_destroy(CoroSemaphore *s) {
+  for (std::coroutine_handle<> h : *s->waiters)
+    h.destroy();
+  pthread_mutex_destroy(&s->lock);
+  delete s->waiters;
+}
+
+// 1 if a permit was free and is now taken
+static inline int coro_sem_try_acquire(CoroSemaphore *s) {
+  pthread_mutex_lock(&s->lock);
+  int taken = s->count > 0;
+  if (taken)
+    s->count--;
+  pthread_mutex_unlock(&s->lock);
+  return taken;
+}
+
+struct CoroSemAcquire {
+  CoroSemaphore *s;
+
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<> h) {
+    CoroSemaphore *sem = s;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count > 0) {
+      sem->count--;
+      pthread_mutex_unlock(&sem->lock);
+      return false;
+    }
+    sem->waiters->push_back(h);
+    pthread_mutex_unlock(&sem->lock);
+    return true;
+  }
+  void await_resume() const noexcept {}
+};
+
+static inline CoroSemAcquire coro_sem_acquire(CoroSemaphore *s) {
+  return CoroSemAcquire{s};
+}
+
+static inline void coro_sem_release(CoroSemaphore *s) {
+  pthread_mutex_lock(&s->lock);
+  if (s->waiters->empty()) {
+    s->count++;
+    pthread_mutex_unlock(&s->lock);
+    return;
+  }
+  std::coroutine_handle<> h = s->waiters->front();
+  s->waiters->pop_front();
+  pthread_mutex_unlock(&s->lock);
+  coro_make_ready(s->ex, h);
+}
+
+// One-shot latch
+
+typedef struct {
+  CoroExecutor *ex;
+  pthread_mutex_t lock;
+  int remaining;
+  std::vector<std::coroutine_handle<>> *waiters;
+} CoroLatch;
+
+static inline void coro_latch_init(CoroLatch *l, CoroExecutor *ex, int count) {
+  l->ex = ex;
+  pthread_mutex_init(&l->lock, NULL);
+  l->remaining = count;
+  l->waiters = new std::vector<std::coroutine_handle<>>();
+}
+
+// Destroys tasks still waiting on the latch
+static inline void coro_latch_destroy(CoroLatch *l) {
+  for (std::coroutine_handle<> h : *l->waiters)
+    h.destroy();
+  pthread_mutex_destroy(&l->lock);
+  delete l->waiters;
+}
+
+// 1 for the count-down that reached zero
+static inline int coro_latch_count_down(CoroLatch *l) {
+  pthread_mutex_lock(&l->lock);
+  int last = --l->remaining == 0;
+  std::vector<std::coroutine_handle<>> wake;
+  if (last)
+    wake.swap(*l->waiters);
+  pthread_mutex_unlock(&l->lock);
+  for (std::coroutine_handle<> h : wake)
+    coro_make_ready(l->ex, h);
+  return last;
+}
+
+struct CoroLatchWait {
+  CoroLatch *l;
+
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<> h) {
+    CoroLatch *latch = l;
+    pthread_mutex_lock(&latch->lock);
+    int wait = latch->remaining > 0;
+    if (wait)
+      latch->waiters->push_back(h);
+    pthread_mutex_unlock(&latch->lock);
+    return wait;
+  }
+  void await_resume() const noexcept {}
+};
+
+static inline CoroLatchWait coro_latch_wait(CoroLatch *l) {
+  return CoroLatchWait{l};
+}
+
+// Reader-writer lock
+
+typedef struct {
+  CoroExecutor *ex;
+  pthread_mutex_t lock;
+  int writer_pref; // hold new readers back while a writer waits
+  int readers;
+  int writer;
+  std::deque<std::coroutine_handle<>> *waiting_readers;
+  std::deque<std::coroutine_handle<>> *waiting_writers;
+} CoroRWLock;
+
+static inline void coro_rw_init(CoroRWLock *rw, CoroExecutor *ex,
+                                int writer_pref) {
+  rw->ex = ex;
+  pthread_mutex_init(&rw->lock, NULL);
+  rw->writer_pref = writer_pref;
+  rw->readers = 0;
+  rw->writer = 0;
+  rw->waiting_readers = new std::deque<std::coroutine_handle<>>();
+  rw->waiting_writers = new std::deque<std::coroutine_handle<>>();
+}
+
+// Destroys tasks still parked for a read or the write
+static inline void coro_rw_destroy(CoroRWLock *rw) {
+  for (std::coroutine_handle<> h : *rw->waiting_readers)
+    h.destroy();
+  for (std::coroutine_handle<> h : *rw->waiting_writers)
+    h.destroy();
+  pthread_mutex_destroy(&rw->lock);
+  delete rw->waiting_readers;
+  delete rw->waiting_writers;
+}
+
+struct CoroReadLock {
+  CoroRWLock *rw;
+  int *queued; // set to 1 if the reader had to wait, may be NULL
+
+  bool await_ready() const noexcept { return false; }
+  // Once h is queued another worker may resume it and free this awaiter,
+  // so nothing of it is touched after the unlock
+  bool await_suspend(std::coroutine_handle<> h) {
+    CoroRWLock *lock = rw;
+    pthread_mutex_lock(&lock->lock);
+    int blocked = lock->writer ||
+                  (lock->writer_pref && !lock->waiting_writers->empty());
+    if (queued)
+      *queued = blocked;
+    if (blocked)
+      lock->waiting_readers->push_back(h);
+    else
+      lock->readers++;
+    pthread_mutex_unlock(&lock->lock);
+    return blocked;
+  }
+  void await_resume() const noexcept {}
+};
+
+struct CoroWriteLock {
+  CoroRWLock *rw;
+  int *queued;
+
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<> h) {
+    CoroRWLock *lock = rw;
+    pthread_mutex_lock(&lock->lock);
+    int blocked = lock->writer || lock->readers > 0;
+    if (queued)
+      *queued = blocked;
+    if (blocked)
+      lock->waiting_writers->push_back(h);
+    else
+      lock->writer = 1;
+    pthread_mutex_unlock(&lock->lock);
+    return blocked;
+  }
+  void await_resume() const noexcept {}
+};
+
+static inline CoroReadLock coro_rw_read_lock(CoroRWLock *rw,
+                                             int *queued = NULL) {
+  return CoroReadLock{rw, queued};
+}
+
+static inline CoroWriteLock coro_rw_write_lock(CoroRWLock *rw,
+                                               int *queued = NULL) {
+  return CoroWriteLock{rw, queued};
+}
+
+static inline void coro_rw_read_unlock(CoroRWLock *rw) {
+  std::coroutine_handle<> writer = nullptr;
+  pthread_mutex_lock(&rw->lock);
+  if (--rw->readers == 0 && !rw->waiting_writers->empty()) {
+    writer = rw->waiting_writers->front();
+    rw->waiting_writers->pop_front();
+    rw->writer = 1;
+  }
+  pthread_mutex_unlock(&rw->lock);
+  if (writer)
+    coro_make_ready(rw->ex, writer);
+}
+
+// Next writer first under writer preference, else every parked reader
+static inline void coro_rw_write_unlock(CoroRWLock *rw) {
+  std::coroutine_handle<> writer = nullptr;
+  std::deque<std::coroutine_handle<>> readers;
+  pthread_mutex_lock(&rw->lock);
+  rw->writer = 0;
+  if (!rw->waiting_writers->empty() &&
+      (rw->writer_pref || rw->waiting_readers->empty())) {
+    writer = rw->waiting_writers->front();
+    rw->waiting_writers->pop_front();
+    rw->writer = 1;
+  } else {
+    readers.swap(*rw->waiting_readers);
+    rw->readers += (int)readers.size();
+  }
+  pthread_mutex_unlock(&rw->lock);
+  if (writer)
+    coro_make_ready(rw->ex, writer);
+  for (std::coroutine_handle<> h : readers)
+    coro_make_ready(rw->ex, h);
+}
+
+#else
+#define CORO_AVAILABLE 0
+#endif
+
+#endif
@@ -0,0 +1,324 @@
+/*
+  Event log shared by the operative simulations (2105110/2105110.cpp and
+  peaky_blinders.cpp).
+
+  Every line the simulations print is one fixed-size EventRecord. By default
+  a record is formatted and written to stdout straight away under a mutex,
+  exactly as the simulations always did.
+
+  After event_log_open("trace.bin") a thread instead appends records to its
+  own single-producer ring buffer: no lock and no syscall on the hot path. A
+  background drainer sweeps all rings and writes the records to the trace
+  file in large batches. trace_format.cpp turns a trace back into the usual
+  text lines, sorted by timestamp.
+
+  Trace file layout: EVENT_TRACE_MAGIC (8 bytes), record size (uint32),
+  reserved (uint32), then EventRecords in drain order.
+*/
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum EventType {
+  EV_OPERATIVE_ARRIVED, // a = operative
+  EV_TYPING_STARTED,    // a = operative, b = station (1-based)
+  EV_TYPING_DONE,       // a = operative
+  EV_UNIT_TYPING_DONE,  // a = unit (1-based)
+  EV_LEADER_LOGBOOK,    // a = unit (1-based), b = leader operative
+  EV_UNIT_LOGGED,       // a = unit (1-based)
+  EV_STAFF_REVIEW,      // a = staff, b = operations completed
+  EV_ALL_DONE
+};
+
+typedef struct {
+  long long time_us; // microseconds since the simulation started
+  int type;
+  int a;
+  int b;
+  int c;
+} EventRecord;
+
+#define EVENT_TRACE_MAGIC "OPTRACE1"
+#define EVENT_RING_SIZE 512 // records per thread, must be a power of two
+#define EVENT_BATCH 4096    // records per write() from the drainer
+
+/**
+ * Format a record as the simulation's text line.
+ * @return Number of characters written, as snprintf.
+ */
+static inline int event_format(const EventRecord *r, char *buf, size_t len) {
+  long long t = r->time_us / 1000000;
+
+  switch (r->type) {
+  case EV_OPERATIVE_ARRIVED:
+    return snprintf(buf, len,
+                    "Operative %d has arrived at typewriting station at time "
+                    "%lld\n",
+                    r->a, t);
+  case EV_TYPING_STARTED:
+    return snprintf(buf, len,
+                    "Operative %d started document recreation at station TS%d "
+                    "at time %lld\n",
+                    r->a, r->b, t);
+  case EV_TYPING_DONE:
+    return snprintf(buf, len,
+                    "Operative %d has completed document recreation at time "
+                    "%lld\n",
+                    r->a, t);
+  case EV_UNIT_TYPING_DONE:
+    return snprintf(buf, len,
+                    "Unit %d has completed document recreation phase at time "
+                    "%lld\n",
+                    r->a, t);
+  case EV_LEADER_LOGBOOK:
+    return snprintf(buf, len,
+                    "Unit %d leader (Operative %d) accessing logbook at time "
+                    "%lld\n",
+                    r->a, r->b, t);
+  case EV_UNIT_LOGGED:
+    return snprintf(buf, len,
+                    "Unit %d has completed intelligence distribution at time "
+                    "%lld\n",
+                    r->a, t);
+  case EV_STAFF_REVIEW:
+    return snprintf(buf, len,
+                    "Intelligence Staff %d began reviewing logbook at time "
+                    "%lld. Operations completed = %d\n",
+                    r->a, t, r->b);
+  case EV_ALL_DONE:
+    return snprintf(buf, len, "All operations completed successfully!\n");
+  }
+  return snprintf(buf, len, "Unknown event %d at time %lld\n", r->type, t);
+}
+
+// One ring per thread. head is only written by the owner, tail only by the
+// drainer; they live on separate cache lines so the two never false-share.
+typedef struct EventRing {
+  EventRecord records[EVENT_RING_SIZE];
+  alignas(64) unsigned int head;
+  alignas(64) unsigned int tail;
+  int closed; // owner thread has exited, free once drained
+  struct EventRing *next;
+} EventRing;
+
+static pthread_mutex_t event_output_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int event_trace_fd = -1;
+
+static pthread_mutex_t event_rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static EventRing *event_rings = NULL;
+static pthread_t event_drainer;
+static int event_drainer_stop = 0;
+static int event_drainer_running = 0; // guarded by event_rings_mutex
+
+// Unlink a ring from event_rings; the caller holds event_rings_mutex
+static inline void event_ring_unlink(EventRing *ring) {
+  EventRing **link = &event_rings;
+  while (*link && *link != ring)
+    link = &(*link)->next;
+  if (*link)
+    *link = ring->next;
+}
+
+// When the thread exits, hands its ring to the drainer to free once
+// drained, or frees it here if the trace is already closed
+struct EventRingOwner {
+  EventRing *ring;
+  ~EventRingOwner() {
+    if (!ring)
+      return;
+    pthread_mutex_lock(&event_rings_mutex);
+    if (event_drainer_running) {
+      __atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+    } else {
+      event_ring_unlink(ring);
+      free(ring);
+    }
+    pthread_mutex_unlock(&event_rings_mutex);
+    ring = NULL;
+  }
+};
+static thread_local EventRingOwner event_ring_owner;
+
+static inline EventRing *event_ring_attach() {
+  EventRing *ring = (EventRing *)aligned_alloc(64, sizeof(EventRing));
+  ring->head = 0;
+  ring->tail = 0;
+  ring->closed = 0;
+
+  pthread_mutex_lock(&event_rings_mutex);
+  ring->next = event_rings;
+  event_rings = ring;
+  pthread_mutex_unlock(&event_rings_mutex);
+
+  event_ring_owner.ring = ring;
+  return ring;
+}
+
+/**
+ * Record one event. Text mode prints the line immediately; trace mode only
+ * copies the record into the calling thread's ring.
+ */
+static inline void log_event(int type, long long time_us, int a = 0, int b = 0,
+                      int c = 0) {
+  EventRecord r = {time_us, type, a, b, c};
+
+  if (event_trace_fd < 0) {
+    char line[160];
+    event_format(&r, line, sizeof(line));
+    pthread_mutex_lock(&event_output_mutex);
+    fputs(line, stdout);
+    fflush(stdout);
+    pthread_mutex_unlock(&event_output_mutex);
+    return;
+  }
+
+  EventRing *ring = event_ring_owner.ring;
+  if (!ring)
+    ring = event_ring_attach();
+
+  unsigned int head = ring->head;
+  // Ring full: the drainer is behind, give it the CPU rather than drop
+  while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) ==
+         EVENT_RING_SIZE)
+    sched_yield();
+
+  ring->records[head & (EVENT_RING_SIZE - 1)] = r;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static inline void event_write_all(const void *data, size_t len) {
+  const char *p = (const char *)data;
+  while (len > 0) {
+    ssize_t n = write(event_trace_fd, p, len);
+    if (n <= 0)
+      return;
+    p += n;
+    len -= n;
+  }
+}
+
+/**
+ * Move everything currently in the rings to the trace file, freeing rings
+ * whose owners have exited.
+ * @return Number of records written.
+ */
+static inline size_t event_drain_rings(EventRecord *batch) {
+  size_t total = 0;
+  size_t count = 0;
+
+  pthread_mutex_lock(&event_rings_mutex);
+  EventRing **link = &event_rings;
+  while (*link) {
+    EventRing *ring = *link;
+    int closed = __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE);
+    unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    unsigned int tail = ring->tail;
+
+    while (tail != head) {
+      batch[count++] = ring->records[tail & (EVENT_RING_SIZE - 1)];
+      tail++;
+      if (count == EVENT_BATCH) {
+        event_write_all(batch, count * sizeof(EventRecord));
+        total += count;
+        count = 0;
+      }
+    }
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+    if (closed) {
+      *link = ring->next;
+      free(ring);
+    } else {
+      link = &ring->next;
+    }
+  }
+  pthread_mutex_unlock(&event_rings_mutex);
+
+  if (count > 0) {
+    event_write_all(batch, count * sizeof(EventRecord));
+    total += count;
+  }
+  return total;
+}
+
+static void *event_drainer_thread(void *arg) {
+  (void)arg;
+  EventRecord *batch =
+      (EventRecord *)malloc(EVENT_BATCH * sizeof(EventRecord));
+
+  while (1) {
+    int stopping = __atomic_load_n(&event_drainer_stop, __ATOMIC_ACQUIRE);
+    size_t drained = event_drain_rings(batch);
+    if (stopping && drained == 0)
+      break;
+    if (drained == 0)
+      usleep(1000);
+  }
+
+  free(batch);
+  return NULL;
+}
+
+/**
+ * Switch to trace mode, writing binary records to the given file.
+ * @return 0 on success, -1 if the file cannot be created.
+ */
+static inline int event_log_open(const char *trace_path) {
+  event_trace_fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (event_trace_fd < 0)
+    return -1;
+
+  uint32_t header[2] = {(uint32_t)sizeof(EventRecord), 0};
+  event_write_all(EVENT_TRACE_MAGIC, 8);
+  event_write_all(header, sizeof(header));
+
+  event_drainer_stop = 0;
+  pthread_mutex_lock(&event_rings_mutex);
+  event_drainer_running = 1;
+  pthread_mutex_unlock(&event_rings_mutex);
+  pthread_create(&event_drainer, NULL, event_drainer_thread, NULL);
+  return 0;
+}
+
+/**
+ * Flush every ring and close the trace. Call once all logging threads are
+ * done; a no-op in text mode. The caller's own ring is freed here; rings of
+ * other threads still alive are drained and left to their owners to free
+ * on exit.
+ */
+static inline void event_log_close() {
+  if (event_trace_fd < 0)
+    return;
+
+  __atomic_store_n(&event_drainer_stop, 1, __ATOMIC_RELEASE);
+  pthread_join(event_drainer, NULL);
+  close(event_trace_fd);
+  event_trace_fd = -1;
+
+  pthread_mutex_lock(&event_rings_mutex);
+  event_drainer_running = 0;
+  EventRing *mine = event_ring_owner.ring;
+  event_ring_owner.ring = NULL;
+  EventRing **link = &event_rings;
+  while (*link) {
+    EventRing *ring = *link;
+    if (ring == mine || __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE)) {
+      *link = ring->next;
+      free(ring);
+    } else {
+      link = &ring->next;
+    }
+  }
+  pthread_mutex_unlock(&event_rings_mutex);
+}
+
+#endif
@@ -0,0 +1,59 @@
+/*
+  futex(2) wrappers for primitives that park threads on a 32-bit word of
+  their own instead of a kernel semaphore or condition variable.
+
+  futex_wait() only sleeps if the word still holds the value the caller saw,
+  so a wake that lands between the caller's check and the call is never
+  lost; it can also return early (signal, spurious wake), so callers always
+  wait in a loop that re-reads the word. All waits are process-private.
+  The header also builds as C (the timeout argument is then required).
+*/
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Sleep while *addr == expected, at most timeout (relative, NULL = forever).
+ * @return 0 when woken, -1 with errno EAGAIN if the word had changed,
+ *         ETIMEDOUT or EINTR otherwise.
+ */
+static inline int futex_wait(int *addr, int expected,
+                             const struct timespec *timeout
+#ifdef __cplusplus
+                             = NULL
+#endif
+) {
+  return (int)syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, timeout,
+                      NULL, 0);
+}
+
+/**
+ * Sleep while *addr == expected, until the absolute deadline on clock
+ * (CLOCK_MONOTONIC or CLOCK_REALTIME; NULL = forever).
+ * @return As futex_wait().
+ */
+static inline int futex_wait_until(int *addr, int expected,
+                                   const struct timespec *deadline,
+                                   clockid_t clock) {
+  int op = FUTEX_WAIT_BITSET_PRIVATE;
+  if (clock == CLOCK_REALTIME)
+    op |= FUTEX_CLOCK_REALTIME;
+  return (int)syscall(SYS_futex, addr, op, expected, deadline, NULL,
+                      FUTEX_BITSET_MATCH_ANY);
+}
+
+// Wake up to count threads sleeping on addr; returns how many woke
+static inline int futex_wake(int *addr, int count) {
+  return (int)syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL,
+                      0);
+}
+
+static inline int futex_wake_all(int *addr) { return futex_wake(addr, INT_MAX); }
+
+#endif
@@ -0,0 +1,74 @@
+/*
+  Drop-in switch of a program's semaphores, mutexes and condition
+  variables from glibc to futex_sync.h, without editing the program:
+
+    gcc -O2 -pthread -include futex_posix.h semaphore.c
+    g++ -O2 -pthread -include futex_posix.h prod_cons_with_mutex.cpp
+    g++ -O2 -pthread -include ../futex_posix.h 2105110.cpp
+
+  The header includes <pthread.h> and <semaphore.h> itself and then
+  renames sem_t, pthread_mutex_t, pthread_cond_t and pthread_condattr_t,
+  their static initializers and the calls on them to the futex_sync.h
+  versions. Everything else (threads, barriers, attributes other than the
+  condition clock) stays glibc's.
+
+  Only what the program names is switched: the few libstdc++ internals that
+  use the same names are included here first and keep glibc's primitives,
+  so std::mutex, std::condition_variable and std::counting_semaphore are
+  unaffected. Semaphores shared between processes and mutex attributes
+  (recursive, error-checking, robust) are not supported.
+*/
+
+#ifndef FUTEX_POSIX_H
+#define FUTEX_POSIX_H
+
+#include <pthread.h>
+#include <semaphore.h>
+
+// libstdc++'s internal headers that name the pthread types or expand their
+// initializers (std::mutex, std::condition_variable, shared_ptr's locks,
+// C++20 semaphores)
+#if defined(__cplusplus) && __has_include(<bits/gthr.h>)
+#include <bits/gthr.h>
+#include <bits/std_mutex.h>
+#include <ext/concurrence.h>
+#if __cplusplus >= 202002L && __has_include(<bits/semaphore_base.h>)
+#include <bits/semaphore_base.h>
+#endif
+#endif
+
+#include "futex_sync.h"
+
+#define sem_t FutexSem
+#define sem_init futex_sem_init
+#define sem_destroy futex_sem_destroy
+#define sem_wait futex_sem_wait
+#define sem_trywait futex_sem_trywait
+#define sem_post futex_sem_post
+#define sem_getvalue futex_sem_getvalue
+
+#undef PTHREAD_MUTEX_INITIALIZER
+#define PTHREAD_MUTEX_INITIALIZER FUTEX_MUTEX_INITIALIZER
+#define pthread_mutex_t FutexMutex
+#define pthread_mutex_init futex_mutex_init
+#define pthread_mutex_destroy futex_mutex_destroy
+#define pthread_mutex_lock futex_mutex_lock
+#define pthread_mutex_trylock futex_mutex_trylock
+#define pthread_mutex_unlock futex_mutex_unlock
+
+#undef PTHREAD_COND_INITIALIZER
+#define PTHREAD_COND_INITIALIZER FUTEX_COND_INITIALIZER
+#define pthread_cond_t FutexCond
+#define pthread_cond_init futex_cond_init
+#define pthread_cond_destroy futex_cond_destroy
+#define pthread_cond_wait futex_cond_wait
+#define pthread_cond_timedwait futex_cond_timedwait
+#define pthread_cond_signal futex_cond_signal
+#define pthread_cond_broadcast futex_cond_broadcast
+
+#define pthread_condattr_t FutexCondAttr
+#define pthread_condattr_init futex_condattr_init
+#define pthread_condattr_destroy futex_condattr_destroy
+#define pthread_condattr_setclock futex_condattr_setclock
+
+#endif
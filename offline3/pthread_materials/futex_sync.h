@@ -0,0 +1,314 @@
+/*
+  Semaphore, mutex and condition variable built directly on futex(2)
+  (futex.h), with the same calls as their POSIX counterparts so a program
+  can switch by renaming (or through futex_posix.h, without touching it).
+
+  Every primitive is a few ints. Taking a free lock or permit and releasing
+  one nobody waits for are a single atomic instruction each, with no system
+  call. A thread that finds it taken first spins for a bounded, adaptive
+  number of rounds (the estimate glibc keeps for PTHREAD_MUTEX_ADAPTIVE_NP:
+  twice the rounds recent acquisitions needed plus ten, capped at
+  FUTEX_SPIN_MAX), since a short critical section is usually over sooner
+  than a sleep and wake-up; on a single CPU it never spins. Only then does
+  it park in futex_wait. A release wakes at most one parked thread, and
+  only when one is parked.
+
+    FutexMutex - Drepper's three-state mutex ("Futexes Are Tricky"):
+                 0 free, 1 locked, 2 locked with threads (maybe) parked.
+                 Unlock only enters the kernel from state 2.
+    FutexSem   - counting semaphore: a permit count and a parked-thread
+                 count; post wakes one thread only if some are parked.
+    FutexCond  - condition variable on a sequence number bumped by every
+                 signal. A woken waiter re-takes the mutex as contended, so
+                 the waiters still behind it are woken in turn. Timed waits
+                 take an absolute deadline on the clock chosen with
+                 futex_condattr_setclock (CLOCK_REALTIME by default, as
+                 for pthread_cond_timedwait).
+
+  All three are process-private; futex_sem_init refuses pshared. Each one
+  counts its parks (futex_wait calls) for lock_bench.cpp. The header also
+  builds as C.
+*/
+
+#ifndef FUTEX_SYNC_H
+#define FUTEX_SYNC_H
+
+#include <errno.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "futex.h"
+
+#define FUTEX_SPIN_MAX 100 // spin rounds before parking, at most
+
+static inline void futex_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+// Spinning only helps when the holder can run meanwhile on another CPU
+static inline int futex_spin_limit(const int *spins) {
+  static int ncpus;
+  if (ncpus == 0)
+    __atomic_store_n(&ncpus, (int)sysconf(_SC_NPROCESSORS_ONLN),
+                     __ATOMIC_RELAXED);
+  if (ncpus <= 1)
+    return 0;
+  int limit = __atomic_load_n(spins, __ATOMIC_RELAXED) * 2 + 10;
+  return limit < FUTEX_SPIN_MAX ? limit : FUTEX_SPIN_MAX;
+}
+
+// Move the estimate an eighth of the way towards the rounds just spun
+static inline void futex_spin_update(int *spins, int rounds) {
+  int s = __atomic_load_n(spins, __ATOMIC_RELAXED);
+  __atomic_store_n(spins, s + (rounds - s) / 8, __ATOMIC_RELAXED);
+}
+
+// Mutex
+
+typedef struct {
+  int state; // 0 free, 1 locked, 2 locked and contended; futex word
+  int spins; // adaptive spin estimate
+  unsigned long long parks;
+} FutexMutex;
+
+#define FUTEX_MUTEX_INITIALIZER {0, 0, 0}
+
+// attr is accepted for the POSIX signature and ignored
+static inline int futex_mutex_init(FutexMutex *m, const void *attr) {
+  (void)attr;
+  m->state = m->spins = 0;
+  m->parks = 0;
+  return 0;
+}
+
+static inline int futex_mutex_destroy(FutexMutex *m) {
+  (void)m;
+  return 0;
+}
+
+/**
+ * Take the mutex if it is free.
+ * @return 0 on success, EBUSY if it is held.
+ */
+static inline int futex_mutex_trylock(FutexMutex *m) {
+  int c = 0;
+  return __atomic_compare_exchange_n(&m->state, &c, 1, 0, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED)
+             ? 0
+             : EBUSY;
+}
+
+// Take the mutex marking it contended, sleeping while someone else holds it
+static inline void futex_mutex_lock_contended(FutexMutex *m) {
+  while (__atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE) != 0) {
+    __atomic_add_fetch(&m->parks, 1, __ATOMIC_RELAXED);
+    futex_wait(&m->state, 2, NULL);
+  }
+}
+
+static inline int futex_mutex_lock(FutexMutex *m) {
+  if (futex_mutex_trylock(m) == 0)
+    return 0;
+  int limit = futex_spin_limit(&m->spins);
+  for (int rounds = 1; rounds <= limit; rounds++) {
+    futex_relax();
+    if (__atomic_load_n(&m->state, __ATOMIC_RELAXED) == 0 &&
+        futex_mutex_trylock(m) == 0) {
+      futex_spin_update(&m->spins, rounds);
+      return 0;
+    }
+  }
+  if (limit > 0)
+    futex_spin_update(&m->spins, limit);
+  futex_mutex_lock_contended(m);
+  return 0;
+}
+
+static inline int futex_mutex_unlock(FutexMutex *m) {
+  if (__atomic_exchange_n(&m->state, 0, __ATOMIC_RELEASE) == 2)
+    futex_wake(&m->state, 1);
+  return 0;
+}
+
+// Counting semaphore
+
+typedef struct {
+  int value;   // free permits, futex word
+  int waiters; // threads parked on value
+  int spins;
+  unsigned long long parks;
+} FutexSem;
+
+/**
+ * @param pshared Must be 0: the semaphore is process-private.
+ * @return 0, or -1 with errno ENOSYS if pshared is set.
+ */
+static inline int futex_sem_init(FutexSem *s, int pshared, unsigned value) {
+  if (pshared) {
+    errno = ENOSYS;
+    return -1;
+  }
+  s->value = (int)value;
+  s->waiters = s->spins = 0;
+  s->parks = 0;
+  return 0;
+}
+
+static inline int futex_sem_destroy(FutexSem *s) {
+  (void)s;
+  return 0;
+}
+
+/**
+ * Take a permit if one is free.
+ * @return 0 on success, -1 with errno EAGAIN if the caller would wait.
+ */
+static inline int futex_sem_trywait(FutexSem *s) {
+  int v = __atomic_load_n(&s->value, __ATOMIC_RELAXED);
+  while (v > 0) {
+    if (__atomic_compare_exchange_n(&s->value, &v, v - 1, 1,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      return 0;
+  }
+  errno = EAGAIN;
+  return -1;
+}
+
+static inline int futex_sem_wait(FutexSem *s) {
+  if (futex_sem_trywait(s) == 0)
+    return 0;
+  int limit = futex_spin_limit(&s->spins);
+  for (int rounds = 1; rounds <= limit; rounds++) {
+    futex_relax();
+    if (__atomic_load_n(&s->value, __ATOMIC_RELAXED) > 0 &&
+        futex_sem_trywait(s) == 0) {
+      futex_spin_update(&s->spins, rounds);
+      return 0;
+    }
+  }
+  if (limit > 0)
+    futex_spin_update(&s->spins, limit);
+
+  // Announce the waiter before re-checking, so a post that misses it in
+  // waiters has already made value non-zero and the futex wait bounces
+  for (;;) {
+    __atomic_add_fetch(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    if (futex_sem_trywait(s) == 0) {
+      __atomic_sub_fetch(&s->waiters, 1, __ATOMIC_RELAXED);
+      return 0;
+    }
+    __atomic_add_fetch(&s->parks, 1, __ATOMIC_RELAXED);
+    futex_wait(&s->value, 0, NULL);
+    __atomic_sub_fetch(&s->waiters, 1, __ATOMIC_RELAXED);
+    if (futex_sem_trywait(s) == 0)
+      return 0;
+  }
+}
+
+static inline int futex_sem_post(FutexSem *s) {
+  __atomic_add_fetch(&s->value, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&s->waiters, __ATOMIC_SEQ_CST) > 0)
+    futex_wake(&s->value, 1);
+  return 0;
+}
+
+static inline int futex_sem_getvalue(FutexSem *s, int *value) {
+  *value = __atomic_load_n(&s->value, __ATOMIC_RELAXED);
+  return 0;
+}
+
+// Condition variable
+
+typedef struct {
+  clockid_t clock;
+} FutexCondAttr;
+
+static inline int futex_condattr_init(FutexCondAttr *a) {
+  a->clock = CLOCK_REALTIME;
+  return 0;
+}
+
+static inline int futex_condattr_destroy(FutexCondAttr *a) {
+  (void)a;
+  return 0;
+}
+
+/**
+ * Pick the clock futex_cond_timedwait deadlines are measured on.
+ * @return 0, or EINVAL unless clock is CLOCK_REALTIME or CLOCK_MONOTONIC.
+ */
+static inline int futex_condattr_setclock(FutexCondAttr *a, clockid_t clock) {
+  if (clock != CLOCK_REALTIME && clock != CLOCK_MONOTONIC)
+    return EINVAL;
+  a->clock = clock;
+  return 0;
+}
+
+typedef struct {
+  int seq;     // bumped by every signal and broadcast, futex word
+  int waiters; // threads between unlocking the mutex and waking
+  clockid_t clock;
+  unsigned long long parks;
+} FutexCond;
+
+#define FUTEX_COND_INITIALIZER {0, 0, CLOCK_REALTIME, 0}
+
+static inline int futex_cond_init(FutexCond *c, const FutexCondAttr *attr) {
+  c->seq = c->waiters = 0;
+  c->clock = attr ? attr->clock : CLOCK_REALTIME;
+  c->parks = 0;
+  return 0;
+}
+
+static inline int futex_cond_destroy(FutexCond *c) {
+  (void)c;
+  return 0;
+}
+
+/**
+ * Unlock m, sleep until signalled or until the absolute deadline on the
+ * condition's clock (NULL = forever), then lock m again. May wake
+ * spuriously, so callers wait in a loop on their predicate.
+ * @return 0, or ETIMEDOUT once the deadline has passed.
+ */
+static inline int futex_cond_timedwait(FutexCond *c, FutexMutex *m,
+                                       const struct timespec *deadline) {
+  // Read under m: a signal sent after the caller checked its predicate
+  // changes seq, and the futex wait below then returns at once
+  int seq = __atomic_load_n(&c->seq, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&c->waiters, 1, __ATOMIC_SEQ_CST);
+  futex_mutex_unlock(m);
+
+  __atomic_add_fetch(&c->parks, 1, __ATOMIC_RELAXED);
+  int timed_out = futex_wait_until(&c->seq, seq, deadline, c->clock) != 0 &&
+                  errno == ETIMEDOUT;
+  __atomic_sub_fetch(&c->waiters, 1, __ATOMIC_RELAXED);
+
+  // Other waiters may be woken behind this one: keep the mutex contended so
+  // each unlock passes it on
+  futex_mutex_lock_contended(m);
+  return timed_out ? ETIMEDOUT : 0;
+}
+
+static inline int futex_cond_wait(FutexCond *c, FutexMutex *m) {
+  return futex_cond_timedwait(c, m, NULL);
+}
+
+static inline int futex_cond_signal(FutexCond *c) {
+  __atomic_add_fetch(&c->seq, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&c->waiters, __ATOMIC_SEQ_CST) > 0)
+    futex_wake(&c->seq, 1);
+  return 0;
+}
+
+static inline int futex_cond_broadcast(FutexCond *c) {
+  __atomic_add_fetch(&c->seq, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&c->waiters, __ATOMIC_SEQ_CST) > 0)
+    futex_wake_all(&c->seq);
+  return 0;
+}
+
+#endif
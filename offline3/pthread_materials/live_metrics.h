@@ -0,0 +1,141 @@
+/*
+  Live metrics segment for running simulations.
+
+  live_open() creates a POSIX shared memory object (/dev/shm/NAME) holding a
+  LiveMetrics struct, and the simulation keeps its counters there with plain
+  atomic adds: no lock and no syscall per update. simtop.cpp maps the same
+  segment read-only and turns the counters into rates while the run goes on.
+
+  Every counter sits on its own cache line, so simulation threads bumping
+  different counters do not bounce one line between cores. Several runs in
+  one process (2105110 --scenarios) all add to the same segment, so a sweep
+  shows up as one stream of arrivals and units.
+
+  Layout (version 1): header line, then one line per counter, in the order
+  of the struct. The writer sets finished before unlinking the segment; a
+  reader that still has it mapped sees the final values.
+*/
+
+#ifndef LIVE_METRICS_H
+#define LIVE_METRICS_H
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define LIVE_MAGIC "SIMLIVE1"
+#define LIVE_VERSION 1
+
+typedef struct {
+  alignas(64) long long value;
+} LiveCounter;
+
+typedef struct {
+  alignas(64) char magic[8];
+  int version;
+  int pid;
+  int finished; // set once the writer is done
+
+  LiveCounter runs_started;
+  LiveCounter runs_finished;
+  LiveCounter operatives_total; // over all runs started so far
+  LiveCounter units_total;
+
+  LiveCounter arrived;              // operatives that have arrived
+  LiveCounter stations_busy;        // seats in use right now
+  LiveCounter typed;                // operatives done typing
+  LiveCounter units_completed;      // units whose members are all done
+  LiveCounter completed_operations; // units written to the logbook
+  LiveCounter readers;              // staff reading the logbook right now
+  LiveCounter writers_waiting;      // leaders queued for the logbook
+  LiveCounter writer_wait_us;       // total time leaders spent queued
+} LiveMetrics;
+
+static inline void live_add(LiveCounter *c, long long delta) {
+  __atomic_add_fetch(&c->value, delta, __ATOMIC_RELAXED);
+}
+
+static inline long long live_read(const LiveCounter *c) {
+  return __atomic_load_n(&c->value, __ATOMIC_RELAXED);
+}
+
+static inline void live_segment_name(const char *name, char *buf,
+                                     size_t len) {
+  snprintf(buf, len, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+/**
+ * Create (or reset) the segment NAME and map it for writing.
+ * @return The mapped counters, or NULL on failure.
+ */
+static inline LiveMetrics *live_open(const char *name) {
+  char path[256];
+  live_segment_name(name, path, sizeof(path));
+
+  int fd = shm_open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return NULL;
+  if (ftruncate(fd, sizeof(LiveMetrics)) != 0) {
+    close(fd);
+    return NULL;
+  }
+  void *map = mmap(NULL, sizeof(LiveMetrics), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  LiveMetrics *live = (LiveMetrics *)map;
+  live->version = LIVE_VERSION;
+  live->pid = (int)getpid();
+  // Magic last: a reader that sees it sees an initialized header
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(live->magic, LIVE_MAGIC, 8);
+  return live;
+}
+
+/**
+ * Map an existing segment read-only (simtop).
+ * @return The counters, or NULL if there is no such segment or it is not a
+ *         version this reader knows.
+ */
+static inline const LiveMetrics *live_attach(const char *name) {
+  char path[256];
+  live_segment_name(name, path, sizeof(path));
+
+  int fd = shm_open(path, O_RDONLY, 0);
+  if (fd < 0)
+    return NULL;
+  void *map = mmap(NULL, sizeof(LiveMetrics), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  const LiveMetrics *live = (const LiveMetrics *)map;
+  if (memcmp(live->magic, LIVE_MAGIC, 8) != 0 ||
+      live->version != LIVE_VERSION) {
+    munmap(map, sizeof(LiveMetrics));
+    return NULL;
+  }
+  return live;
+}
+
+static inline void live_detach(const LiveMetrics *live) {
+  munmap((void *)live, sizeof(LiveMetrics));
+}
+
+/**
+ * Mark the segment finished, then unmap and remove it.
+ */
+static inline void live_close(LiveMetrics *live, const char *name) {
+  char path[256];
+  live_segment_name(name, path, sizeof(path));
+
+  __atomic_store_n(&live->finished, 1, __ATOMIC_RELEASE);
+  munmap(live, sizeof(LiveMetrics));
+  shm_unlink(path);
+}
+
+#endif
@@ -0,0 +1,359 @@
+/*
+  Lock benchmark: glibc's pthread_mutex_t, sem_t and pthread_cond_t
+  (default attributes, as every program here uses them) against
+  futex_sync.h under contention.
+
+  T threads each run OPS operations of a primitive. Every critical section
+  spins for CS nanoseconds and bumps a plain shared counter; between
+  operations a thread spins THINK nanoseconds outside. Primitives:
+
+    mutex  - lock, critical section, unlock
+    sem    - a binary semaphore used as the lock, as in semaphore.c:
+             wait, critical section, post
+    cond   - prod_cons_with_mutex.cpp's bounded buffer of 4 slots with a
+             mutex and "not full" / "not empty" condition variables; half
+             the threads produce, half consume (T is rounded up to even)
+
+  each as posix (glibc) and futex (FutexMutex, FutexSem, FutexCond). One
+  CSV row per run:
+
+    primitive,impl,threads,cs_ns,think_ns,ops,rep,wall_s,ops_per_s,
+    speedup,parks,ok,user_s,sys_s,vol_ctx_switches,invol_ctx_switches
+
+  ops is per thread, ops_per_s over all threads, speedup against posix on
+  the same primitive, threads and lengths. parks counts the futex
+  implementation's futex_wait calls (empty for posix); ok whether the
+  shared counter (or the consumers' checksum) came out exact, i.e. the
+  primitive excluded and lost nothing. CPU time and context switches are
+  getrusage deltas over the run.
+
+  Compilation:
+    g++ -O2 -pthread lock_bench.cpp -o lock_bench
+
+  Usage:
+    ./lock_bench [--primitive LIST] [--threads LIST] [--cs LIST]
+                 [--think NS] [--ops N] [--reps K] [--out FILE]
+
+    LIST is comma separated. Defaults: --primitive mutex,sem,cond
+    --threads 1,2,4,8,16 --cs 0,100,1000 --think 100 --ops 200000 --reps 1,
+    CSV on stdout.
+*/
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+#include <time.h>
+#include <vector>
+
+#include "bench_util.h"
+#include "futex_sync.h"
+
+#define SLOTS 4 // cond: bounded buffer size
+
+enum { PRIM_MUTEX, PRIM_SEM, PRIM_COND };
+static const char *prim_names[] = {"mutex", "sem", "cond"};
+enum { IMPL_POSIX, IMPL_FUTEX };
+static const char *impl_names[] = {"posix", "futex"};
+
+// The two implementations behind one set of calls
+
+struct PosixSync {
+  pthread_mutex_t lock;
+  sem_t sem;
+  pthread_cond_t not_full, not_empty;
+
+  void init() {
+    pthread_mutex_init(&lock, NULL);
+    sem_init(&sem, 0, 1);
+    pthread_cond_init(&not_full, NULL);
+    pthread_cond_init(&not_empty, NULL);
+  }
+  void destroy() {
+    pthread_mutex_destroy(&lock);
+    sem_destroy(&sem);
+    pthread_cond_destroy(&not_full);
+    pthread_cond_destroy(&not_empty);
+  }
+  void mutex_lock() { pthread_mutex_lock(&lock); }
+  void mutex_unlock() { pthread_mutex_unlock(&lock); }
+  void sem_take() { sem_wait(&sem); }
+  void sem_give() { sem_post(&sem); }
+  void wait_not_full() { pthread_cond_wait(&not_full, &lock); }
+  void wait_not_empty() { pthread_cond_wait(&not_empty, &lock); }
+  void signal_not_full() { pthread_cond_signal(&not_full); }
+  void signal_not_empty() { pthread_cond_signal(&not_empty); }
+  long long parks() { return -1; }
+};
+
+struct FutexSync {
+  FutexMutex lock;
+  FutexSem sem;
+  FutexCond not_full, not_empty;
+
+  void init() {
+    futex_mutex_init(&lock, NULL);
+    futex_sem_init(&sem, 0, 1);
+    futex_cond_init(&not_full, NULL);
+    futex_cond_init(&not_empty, NULL);
+  }
+  void destroy() {}
+  void mutex_lock() { futex_mutex_lock(&lock); }
+  void mutex_unlock() { futex_mutex_unlock(&lock); }
+  void sem_take() { futex_sem_wait(&sem); }
+  void sem_give() { futex_sem_post(&sem); }
+  void wait_not_full() { futex_cond_wait(&not_full, &lock); }
+  void wait_not_empty() { futex_cond_wait(&not_empty, &lock); }
+  void signal_not_full() { futex_cond_signal(&not_full); }
+  void signal_not_empty() { futex_cond_signal(&not_empty); }
+  long long parks() {
+    return lock.parks + sem.parks + not_full.parks + not_empty.parks;
+  }
+};
+
+template <typename Sync> struct Shared {
+  Sync sync;
+  int prim;
+  long long ops;
+  long cs_iters, think_iters;
+  long long counter; // bumped only inside critical sections
+  long long slots[SLOTS];
+  int head, count;
+};
+
+template <typename Sync> struct Worker {
+  Shared<Sync> *shared;
+  int producer;       // cond: producer or consumer
+  long long first;    // cond: first item id this producer pushes
+  long long checksum; // cond: sum of the items this consumer popped
+};
+
+// Busy work of a calibrated length, which the compiler cannot drop
+static inline void spin(long iters) {
+  for (long i = 0; i < iters; i++)
+    __asm__ __volatile__("" ::: "memory");
+}
+
+template <typename Sync> static void *bench_thread(void *arg) {
+  Worker<Sync> *w = (Worker<Sync> *)arg;
+  Shared<Sync> *s = w->shared;
+  Sync *sync = &s->sync;
+
+  for (long long i = 0; i < s->ops; i++) {
+    switch (s->prim) {
+    case PRIM_MUTEX:
+      sync->mutex_lock();
+      spin(s->cs_iters);
+      s->counter++;
+      sync->mutex_unlock();
+      break;
+    case PRIM_SEM:
+      sync->sem_take();
+      spin(s->cs_iters);
+      s->counter++;
+      sync->sem_give();
+      break;
+    default:
+      sync->mutex_lock();
+      if (w->producer) {
+        while (s->count == SLOTS)
+          sync->wait_not_full();
+        s->slots[(s->head + s->count) % SLOTS] = w->first + i;
+        s->count++;
+        spin(s->cs_iters);
+        sync->signal_not_empty();
+      } else {
+        while (s->count == 0)
+          sync->wait_not_empty();
+        w->checksum += s->slots[s->head];
+        s->head = (s->head + 1) % SLOTS;
+        s->count--;
+        spin(s->cs_iters);
+        sync->signal_not_full();
+      }
+      s->counter++;
+      sync->mutex_unlock();
+    }
+    spin(s->think_iters);
+  }
+  return NULL;
+}
+
+typedef struct {
+  double wall;
+  long long parks;
+  int ok;
+} RunResult;
+
+template <typename Sync>
+static RunResult run(int prim, int threads, long long ops, long cs_iters,
+                     long think_iters) {
+  Shared<Sync> *s = new Shared<Sync>();
+  s->sync.init();
+  s->prim = prim;
+  s->ops = ops;
+  s->cs_iters = cs_iters;
+  s->think_iters = think_iters;
+  s->counter = 0;
+  s->head = s->count = 0;
+
+  std::vector<Worker<Sync>> workers(threads);
+  std::vector<pthread_t> tids(threads);
+  for (int i = 0; i < threads; i++) {
+    workers[i].shared = s;
+    workers[i].producer = i % 2 == 0;
+    workers[i].first = (long long)(i / 2) * ops;
+    workers[i].checksum = 0;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < threads; i++)
+    pthread_create(&tids[i], NULL, bench_thread<Sync>, &workers[i]);
+  for (pthread_t t : tids)
+    pthread_join(t, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  RunResult r;
+  r.wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  r.parks = s->sync.parks();
+  r.ok = s->counter == threads * ops;
+  if (prim == PRIM_COND) {
+    // Producers pushed 0 .. threads / 2 * ops - 1, each once
+    long long pushed = threads / 2 * ops, sum = 0;
+    for (Worker<Sync> &w : workers)
+      sum += w.checksum;
+    r.ok = r.ok && sum == pushed * (pushed - 1) / 2;
+  }
+  s->sync.destroy();
+  delete s;
+  return r;
+}
+
+// Iterations of spin() per nanosecond on this machine
+static double calibrate() {
+  long iters = 1 << 20;
+  for (;;) {
+    struct timespec a, b;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    spin(iters);
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    double ns = (b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec);
+    if (ns > 20e6)
+      return iters / ns;
+    iters *= 2;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<int> prims = {PRIM_MUTEX, PRIM_SEM, PRIM_COND};
+  std::vector<int> thread_counts = {1, 2, 4, 8, 16};
+  std::vector<int> cs_lengths = {0, 100, 1000};
+  int think = 100, reps = 1;
+  long long ops = 200000;
+  const char *out_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (strcmp(arg, "--primitive") == 0) {
+      prims.clear();
+      std::string name;
+      for (const char *p = value;; p++) {
+        if (*p == ',' || *p == '\0') {
+          int prim = -1;
+          for (int k = 0; k < 3; k++)
+            if (name == prim_names[k])
+              prim = k;
+          if (prim < 0) {
+            fprintf(stderr, "Unknown primitive %s\n", name.c_str());
+            return 1;
+          }
+          prims.push_back(prim);
+          name.clear();
+          if (*p == '\0')
+            break;
+        } else {
+          name += *p;
+        }
+      }
+    } else if (strcmp(arg, "--threads") == 0)
+      thread_counts = parse_list(value);
+    else if (strcmp(arg, "--cs") == 0)
+      cs_lengths = parse_list(value);
+    else if (strcmp(arg, "--think") == 0)
+      think = atoi(value);
+    else if (strcmp(arg, "--ops") == 0)
+      ops = atoll(value);
+    else if (strcmp(arg, "--reps") == 0)
+      reps = atoi(value);
+    else if (strcmp(arg, "--out") == 0)
+      out_path = value;
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+  if (ops <= 0 || reps <= 0 || think < 0) {
+    fprintf(stderr, "Ops and reps must be positive, think not negative\n");
+    return 1;
+  }
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Error opening %s\n", out_path);
+    return 1;
+  }
+  double iters_per_ns = calibrate();
+  fprintf(out, "primitive,impl,threads,cs_ns,think_ns,ops,rep,wall_s,"
+               "ops_per_s,speedup,parks,ok,user_s,sys_s,vol_ctx_switches,"
+               "invol_ctx_switches\n");
+
+  for (int prim : prims)
+    for (int threads : thread_counts)
+      for (int cs : cs_lengths) {
+        if (threads <= 0 || cs < 0)
+          continue;
+        // cond needs a consumer for every producer
+        int t = prim == PRIM_COND ? (threads + 1) / 2 * 2 : threads;
+        long cs_iters = (long)(cs * iters_per_ns);
+        long think_iters = (long)(think * iters_per_ns);
+        double baseline = 0;
+        for (int impl = IMPL_POSIX; impl <= IMPL_FUTEX; impl++)
+          for (int rep = 0; rep < reps; rep++) {
+            struct rusage before, after;
+            getrusage(RUSAGE_SELF, &before);
+            RunResult r =
+                impl == IMPL_POSIX
+                    ? run<PosixSync>(prim, t, ops, cs_iters, think_iters)
+                    : run<FutexSync>(prim, t, ops, cs_iters, think_iters);
+            getrusage(RUSAGE_SELF, &after);
+            double rate = r.wall > 0 ? t * ops / r.wall : 0;
+            if (impl == IMPL_POSIX && rep == 0)
+              baseline = rate;
+
+            fprintf(out, "%s,%s,%d,%d,%d,%lld,%d,%.6f,%.1f,%.2f,",
+                    prim_names[prim], impl_names[impl], t, cs, think, ops,
+                    rep, r.wall, rate, baseline > 0 ? rate / baseline : 0.0);
+            if (r.parks >= 0)
+              fprintf(out, "%lld", r.parks);
+            fprintf(out, ",%d,%.6f,%.6f,%ld,%ld\n", r.ok,
+                    tv_s(after.ru_utime) - tv_s(before.ru_utime),
+                    tv_s(after.ru_stime) - tv_s(before.ru_stime),
+                    after.ru_nvcsw - before.ru_nvcsw,
+                    after.ru_nivcsw - before.ru_nivcsw);
+            fflush(out);
+          }
+      }
+
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
@@ -0,0 +1,348 @@
+/*
+  Reader-writer lock guarding the logbook in the operative simulations, with
+  a selectable policy:
+
+    reader     - classic reader-preferring solution: the first reader takes
+                 write_sem, the last one gives it back. Writers can starve
+                 while readers keep overlapping.
+    writer     - writer-preferring: once a writer is waiting no new reader
+                 gets in.
+    phase-fair - readers and writers alternate. A reader that finds a writer
+                 active or waiting waits for exactly one write phase; a
+                 writer waits for the readers admitted before it.
+    seqlock    - readers never block. Writers exclude each other and publish
+                 values inside a sequence-counter window; readers retry a
+                 read that overlapped a publish.
+
+  Readers and writers only touch logbook fields through logbook_read_value()
+  and logbook_write_value(), which is what lets seqlock readers skip the lock.
+
+  The lock also keeps the numbers needed to compare policies (metrics.h):
+  writer wait and hold times, writer queue depth, and reader wait and
+  throughput. logbook_report() prints them at the end of a run.
+*/
+
+#ifndef LOGBOOK_H
+#define LOGBOOK_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "metrics.h"
+
+enum LogbookPolicy {
+  LOGBOOK_READER_PREF,
+  LOGBOOK_WRITER_PREF,
+  LOGBOOK_PHASE_FAIR,
+  LOGBOOK_SEQLOCK
+};
+
+static const char *logbook_policy_names[] = {"reader", "writer", "phase-fair",
+                                             "seqlock"};
+
+typedef struct {
+  int policy;
+
+  // reader: the original read_count / read_count_mutex / write_sem trio
+  sem_t write_sem;
+  pthread_mutex_t read_count_mutex;
+  int read_count;
+
+  // writer, phase-fair and seqlock writers
+  pthread_mutex_t lock;
+  pthread_cond_t readers_ok;
+  pthread_cond_t writers_ok;
+  int readers;
+  int writer;
+  int waiting_readers;
+  int waiting_writers;
+  int readers_pending; // phase-fair: readers let in by the last write phase
+  unsigned int phase;  // phase-fair: bumped on every writer release
+
+  unsigned int seq; // seqlock: odd while a value is being published
+
+  // Metrics, updated atomically
+  ResourceStats write_stats;
+  ResourceStats read_stats;
+  long long write_start_us; // when the current writer got in
+} Logbook;
+
+/**
+ * Parse a policy name as accepted on the command line.
+ * @return The policy, or -1 if the name is unknown.
+ */
+static inline int logbook_parse_policy(const char *name) {
+  for (int i = 0; i < 4; i++) {
+    if (strcmp(name, logbook_policy_names[i]) == 0)
+      return i;
+  }
+  return -1;
+}
+
+static inline long long logbook_clock_us() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+static inline void logbook_init(Logbook *lb, int policy) {
+  memset(lb, 0, sizeof(*lb));
+  lb->policy = policy;
+  resource_init(&lb->write_stats, 1);
+  resource_init(&lb->read_stats, 0);
+  sem_init(&lb->write_sem, 0, 1);
+  pthread_mutex_init(&lb->read_count_mutex, NULL);
+  pthread_mutex_init(&lb->lock, NULL);
+  pthread_cond_init(&lb->readers_ok, NULL);
+  pthread_cond_init(&lb->writers_ok, NULL);
+}
+
+static inline void logbook_destroy(Logbook *lb) {
+  sem_destroy(&lb->write_sem);
+  pthread_mutex_destroy(&lb->read_count_mutex);
+  pthread_mutex_destroy(&lb->lock);
+  pthread_cond_destroy(&lb->readers_ok);
+  pthread_cond_destroy(&lb->writers_ok);
+}
+
+/*
+  Metric hooks. The lock functions below call them; schedulers that apply a
+  policy themselves (pool mode in 2105110.cpp) call them directly.
+*/
+
+// A writer found the logbook busy and starts waiting
+static inline void logbook_note_write_queued(Logbook *lb) {
+  resource_enqueue(&lb->write_stats);
+}
+
+static inline void logbook_note_write(Logbook *lb, long long wait_us,
+                                      int queued) {
+  resource_acquired(&lb->write_stats, wait_us, queued);
+}
+
+static inline void logbook_note_write_done(Logbook *lb, long long held_us) {
+  resource_released(&lb->write_stats, held_us);
+}
+
+static inline void logbook_note_read(Logbook *lb, long long wait_us) {
+  resource_acquired(&lb->read_stats, wait_us, 0);
+}
+
+static inline void logbook_read_lock(Logbook *lb) {
+  long long start = logbook_clock_us();
+
+  switch (lb->policy) {
+  case LOGBOOK_READER_PREF:
+    pthread_mutex_lock(&lb->read_count_mutex);
+    lb->read_count++;
+    if (lb->read_count == 1)
+      sem_wait(&lb->write_sem); // first reader locks writers out
+    pthread_mutex_unlock(&lb->read_count_mutex);
+    break;
+
+  case LOGBOOK_WRITER_PREF:
+    pthread_mutex_lock(&lb->lock);
+    while (lb->writer || lb->waiting_writers > 0)
+      pthread_cond_wait(&lb->readers_ok, &lb->lock);
+    lb->readers++;
+    pthread_mutex_unlock(&lb->lock);
+    break;
+
+  case LOGBOOK_PHASE_FAIR:
+    pthread_mutex_lock(&lb->lock);
+    if (lb->writer || lb->waiting_writers > 0) {
+      unsigned int phase = lb->phase;
+      lb->waiting_readers++;
+      while (lb->phase == phase)
+        pthread_cond_wait(&lb->readers_ok, &lb->lock);
+      lb->waiting_readers--;
+      lb->readers_pending--;
+    }
+    lb->readers++;
+    pthread_mutex_unlock(&lb->lock);
+    break;
+
+  case LOGBOOK_SEQLOCK:
+    break;
+  }
+
+  logbook_note_read(lb, logbook_clock_us() - start);
+}
+
+static inline void logbook_read_unlock(Logbook *lb) {
+  switch (lb->policy) {
+  case LOGBOOK_READER_PREF:
+    pthread_mutex_lock(&lb->read_count_mutex);
+    lb->read_count--;
+    if (lb->read_count == 0)
+      sem_post(&lb->write_sem); // last reader lets writers in
+    pthread_mutex_unlock(&lb->read_count_mutex);
+    break;
+
+  case LOGBOOK_WRITER_PREF:
+  case LOGBOOK_PHASE_FAIR:
+    pthread_mutex_lock(&lb->lock);
+    lb->readers--;
+    if (lb->readers == 0 && lb->readers_pending == 0)
+      pthread_cond_signal(&lb->writers_ok);
+    pthread_mutex_unlock(&lb->lock);
+    break;
+
+  case LOGBOOK_SEQLOCK:
+    break;
+  }
+}
+
+static inline void logbook_write_lock(Logbook *lb) {
+  int queued = 0;
+  long long start = logbook_clock_us();
+
+  switch (lb->policy) {
+  case LOGBOOK_READER_PREF:
+    if (sem_trywait(&lb->write_sem) != 0) {
+      queued = 1;
+      logbook_note_write_queued(lb);
+      sem_wait(&lb->write_sem);
+    }
+    break;
+
+  case LOGBOOK_WRITER_PREF:
+  case LOGBOOK_PHASE_FAIR:
+    pthread_mutex_lock(&lb->lock);
+    lb->waiting_writers++;
+    while (lb->writer || lb->readers > 0 || lb->readers_pending > 0) {
+      if (!queued) {
+        queued = 1;
+        logbook_note_write_queued(lb);
+      }
+      pthread_cond_wait(&lb->writers_ok, &lb->lock);
+    }
+    lb->waiting_writers--;
+    lb->writer = 1;
+    pthread_mutex_unlock(&lb->lock);
+    break;
+
+  case LOGBOOK_SEQLOCK:
+    // writers still exclude each other
+    if (pthread_mutex_trylock(&lb->lock) != 0) {
+      queued = 1;
+      logbook_note_write_queued(lb);
+      pthread_mutex_lock(&lb->lock);
+    }
+    break;
+  }
+
+  lb->write_start_us = logbook_clock_us();
+  logbook_note_write(lb, lb->write_start_us - start, queued);
+}
+
+static inline void logbook_write_unlock(Logbook *lb) {
+  logbook_note_write_done(lb, logbook_clock_us() - lb->write_start_us);
+
+  switch (lb->policy) {
+  case LOGBOOK_READER_PREF:
+    sem_post(&lb->write_sem);
+    break;
+
+  case LOGBOOK_WRITER_PREF:
+    pthread_mutex_lock(&lb->lock);
+    lb->writer = 0;
+    if (lb->waiting_writers > 0)
+      pthread_cond_signal(&lb->writers_ok);
+    else
+      pthread_cond_broadcast(&lb->readers_ok);
+    pthread_mutex_unlock(&lb->lock);
+    break;
+
+  case LOGBOOK_PHASE_FAIR:
+    pthread_mutex_lock(&lb->lock);
+    lb->writer = 0;
+    lb->phase++;
+    lb->readers_pending = lb->waiting_readers;
+    if (lb->readers_pending > 0)
+      pthread_cond_broadcast(&lb->readers_ok);
+    else
+      pthread_cond_signal(&lb->writers_ok);
+    pthread_mutex_unlock(&lb->lock);
+    break;
+
+  case LOGBOOK_SEQLOCK:
+    pthread_mutex_unlock(&lb->lock);
+    break;
+  }
+}
+
+/**
+ * Read a logbook field. Under seqlock the read is retried until it did not
+ * overlap a publish; under the other policies the read lock already
+ * guarantees a stable value.
+ */
+static inline int logbook_read_value(Logbook *lb, const int *field) {
+  if (lb->policy != LOGBOOK_SEQLOCK)
+    return __atomic_load_n(field, __ATOMIC_RELAXED);
+
+  while (1) {
+    unsigned int seq = __atomic_load_n(&lb->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) {
+      sched_yield();
+      continue;
+    }
+    int value = __atomic_load_n(field, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&lb->seq, __ATOMIC_RELAXED) == seq)
+      return value;
+  }
+}
+
+/**
+ * Update a logbook field. Must be called with the write lock held.
+ */
+static inline void logbook_write_value(Logbook *lb, int *field, int value) {
+  if (lb->policy != LOGBOOK_SEQLOCK) {
+    __atomic_store_n(field, value, __ATOMIC_RELAXED);
+    return;
+  }
+
+  __atomic_store_n(&lb->seq, lb->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(field, value, __ATOMIC_RELAXED);
+  __atomic_store_n(&lb->seq, lb->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Print the policy and its reader numbers for a run that lasted elapsed_us.
+ * The writer side is a metrics.h table row (resource_report_row() with
+ * lb->write_stats) so it lines up with the stations.
+ */
+static inline void logbook_report(Logbook *lb, long long elapsed_us,
+                                  FILE *out) {
+  const Histogram *w = &lb->read_stats.wait;
+  double seconds = elapsed_us / 1e6;
+  fprintf(out, "Logbook policy: %s\n", logbook_policy_names[lb->policy]);
+  fprintf(out,
+          "Logbook reads: %lld, reader wait avg %.3f s, p99 %.3f s, "
+          "throughput %.3f reads/s\n",
+          w->count, w->count ? w->sum_us / 1e6 / w->count : 0.0,
+          hist_percentile(w, 99) / 1e6, seconds > 0 ? w->count / seconds : 0.0);
+}
+
+// JSON counterpart of logbook_report(), writer stats included
+static inline void logbook_report_json(Logbook *lb, long long elapsed_us,
+                                       FILE *out) {
+  const Histogram *w = &lb->read_stats.wait;
+  double seconds = elapsed_us / 1e6;
+  fprintf(out, "{\"policy\": \"%s\", \"writes\": ",
+          logbook_policy_names[lb->policy]);
+  resource_report_json(out, "logbook", &lb->write_stats, elapsed_us);
+  fprintf(out,
+          ", \"reads\": {\"count\": %lld, \"wait_us_mean\": %lld, "
+          "\"wait_us_p99\": %lld, \"per_second\": %.4f}}",
+          w->count, w->count ? w->sum_us / w->count : 0,
+          hist_percentile(w, 99), seconds > 0 ? w->count / seconds : 0.0);
+}
+
+#endif
@@ -0,0 +1,170 @@
+/*
+  Queueing metrics for the shared resources of the operative simulations
+  (typewriting stations, the logbook).
+
+  A ResourceStats follows one resource: how long clients waited to get it
+  (log-bucketed histogram, so p50/p95/p99 come out without storing samples),
+  how long they held it, the deepest its wait queue got, and from the total
+  hold time its utilization over the run. All updates are lock-free atomics
+  so instrumentation does not add a lock of its own to the measured path.
+
+  Histogram buckets: values below 16 us get one bucket each, above that every
+  power of two is split into 8 sub-buckets, so a reported percentile is
+  within about 12% of the real value.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <string.h>
+
+#define HIST_BUCKETS (16 + 60 * 8)
+
+typedef struct {
+  long long count;
+  long long sum_us;
+  long long max_us;
+  long long buckets[HIST_BUCKETS];
+} Histogram;
+
+typedef struct {
+  int capacity;     // clients the resource serves at once
+  int queued;       // clients waiting right now
+  int max_queued;   // deepest the wait queue got
+  Histogram wait;   // time from asking to getting the resource
+  Histogram service; // time holding it
+} ResourceStats;
+
+static inline int hist_bucket(long long us) {
+  if (us < 16)
+    return us < 0 ? 0 : (int)us;
+  int msb = 63 - __builtin_clzll((unsigned long long)us);
+  return 16 + (msb - 4) * 8 + (int)((us >> (msb - 3)) & 7);
+}
+
+// Smallest value that falls into bucket b
+static inline long long hist_bucket_floor(int b) {
+  if (b < 16)
+    return b;
+  int msb = (b - 16) / 8 + 4;
+  return (8LL + (b - 16) % 8) << (msb - 3);
+}
+
+static inline void metrics_atomic_max(long long *target, long long value) {
+  long long seen = __atomic_load_n(target, __ATOMIC_RELAXED);
+  while (value > seen &&
+         !__atomic_compare_exchange_n(target, &seen, value, 0,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+static inline void metrics_atomic_min(long long *target, long long value) {
+  long long seen = __atomic_load_n(target, __ATOMIC_RELAXED);
+  while (value < seen &&
+         !__atomic_compare_exchange_n(target, &seen, value, 0,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+static inline void hist_record(Histogram *h, long long us) {
+  __atomic_add_fetch(&h->count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&h->sum_us, us, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&h->buckets[hist_bucket(us)], 1, __ATOMIC_RELAXED);
+  metrics_atomic_max(&h->max_us, us);
+}
+
+/**
+ * Approximate percentile (0 < p <= 100) as the floor of the bucket holding
+ * it, capped at the recorded maximum.
+ */
+static inline long long hist_percentile(const Histogram *h, double p) {
+  if (h->count == 0)
+    return 0;
+  long long rank = (long long)(h->count * p / 100.0 + 0.5);
+  if (rank < 1)
+    rank = 1;
+  long long seen = 0;
+  for (int b = 0; b < HIST_BUCKETS; b++) {
+    seen += h->buckets[b];
+    if (seen >= rank) {
+      long long v = hist_bucket_floor(b);
+      return v < h->max_us ? v : h->max_us;
+    }
+  }
+  return h->max_us;
+}
+
+static inline void resource_init(ResourceStats *r, int capacity) {
+  memset(r, 0, sizeof(*r));
+  r->capacity = capacity;
+}
+
+// A client found the resource busy and starts waiting
+static inline void resource_enqueue(ResourceStats *r) {
+  int depth = __atomic_add_fetch(&r->queued, 1, __ATOMIC_RELAXED);
+  int seen = __atomic_load_n(&r->max_queued, __ATOMIC_RELAXED);
+  while (depth > seen &&
+         !__atomic_compare_exchange_n(&r->max_queued, &seen, depth, 0,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+// A client got the resource; queued says whether it went through enqueue
+static inline void resource_acquired(ResourceStats *r, long long wait_us,
+                                     int queued) {
+  if (queued)
+    __atomic_sub_fetch(&r->queued, 1, __ATOMIC_RELAXED);
+  hist_record(&r->wait, wait_us);
+}
+
+static inline void resource_released(ResourceStats *r, long long held_us) {
+  hist_record(&r->service, held_us);
+}
+
+static inline double resource_utilization(const ResourceStats *r,
+                                          long long elapsed_us) {
+  if (elapsed_us <= 0 || r->capacity <= 0)
+    return 0;
+  return (double)r->service.sum_us / ((double)elapsed_us * r->capacity);
+}
+
+static inline void resource_report_header(FILE *out) {
+  fprintf(out, "%-10s %8s %10s %10s %10s %10s %10s %8s %6s\n", "resource",
+          "served", "wait p50", "wait p95", "wait p99", "wait max",
+          "service", "util", "maxq");
+}
+
+// One table row; times in seconds, service is the mean hold time
+static inline void resource_report_row(FILE *out, const char *name,
+                                       const ResourceStats *r,
+                                       long long elapsed_us) {
+  const Histogram *w = &r->wait;
+  fprintf(out, "%-10s %8lld %10.3f %10.3f %10.3f %10.3f %10.3f %7.1f%% %6d\n",
+          name, w->count, hist_percentile(w, 50) / 1e6,
+          hist_percentile(w, 95) / 1e6, hist_percentile(w, 99) / 1e6,
+          w->max_us / 1e6,
+          r->service.count ? r->service.sum_us / 1e6 / r->service.count : 0.0,
+          resource_utilization(r, elapsed_us) * 100, r->max_queued);
+}
+
+// One JSON object, times in microseconds
+static inline void resource_report_json(FILE *out, const char *name,
+                                        const ResourceStats *r,
+                                        long long elapsed_us) {
+  const Histogram *w = &r->wait;
+  fprintf(out,
+          "{\"name\": \"%s\", \"capacity\": %d, \"served\": %lld, "
+          "\"wait_us\": {\"mean\": %lld, \"p50\": %lld, \"p95\": %lld, "
+          "\"p99\": %lld, \"max\": %lld}, "
+          "\"service_us\": {\"mean\": %lld, \"max\": %lld}, "
+          "\"utilization\": %.4f, \"max_queue\": %d}",
+          name, r->capacity, w->count, w->count ? w->sum_us / w->count : 0,
+          hist_percentile(w, 50), hist_percentile(w, 95),
+          hist_percentile(w, 99), w->max_us,
+          r->service.count ? r->service.sum_us / r->service.count : 0,
+          r->service.max_us, resource_utilization(r, elapsed_us),
+          r->max_queued);
+}
+
+#endif
@@ -5,7 +5,14 @@
 #include <unistd.h>
 #include <time.h>
 #include <math.h>
+#include <string.h>
+#include <sys/time.h>
 #include <random>
+#include "event_log.h"
+#include "logbook.h"
+#include "stations.h"
+#include "sim_random.h"
+#include "sync_backend.h"
 using namespace std;
 
 // Structure for operative data
@@ -26,31 +33,41 @@ typedef struct {
 // Global variables
 int N, M, x, y; // N=operatives, M=unit size, x=doc recreation time, y=logbook time
 int completed_operations = 0; // Shared counter for completed operations
-int *unit_completion_count; // Track completion count for each unit
-pthread_mutex_t *unit_mutex; // Mutex for each unit
+SyncLatch *unit_latches; // Members left in each unit, backend set by --sync
 pthread_mutex_t logbook_mutex; // Mutex for logbook access
-pthread_mutex_t reader_count_mutex; // Mutex for reader count
-sem_t *station_semaphores; // Semaphores for 4 typewriting stations
-sem_t write_sem; // Semaphore for writer access to logbook
-int reader_count = 0; // Number of active readers
+StationSet stations; // Typewriting stations, count/capacity/dispatch set on the command line
+Logbook logbook; // Reader-writer lock for the logbook, policy set by --logbook
 time_t start_time; // Start time of the program
 
+// Group commit: units that finish while a logbook write is in progress queue
+// up here, and the next write commits all of them under one write lock hold.
+// --commit unit goes back to one logbook write per unit.
+int group_commit = 1;
+pthread_mutex_t commit_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t commit_done = PTHREAD_COND_INITIALIZER;
+int *commit_pending; // units waiting for the next write
+int *commit_batch; // units in the write under way, only touched by the committer
+int commit_pending_count = 0;
+int commit_writer_active = 0;
+long long commit_tickets = 0; // units queued so far
+long long commit_durable = 0; // units committed so far
+int commit_writes = 0;
+int commit_max_batch = 0;
+
+// Shutdown: set once every operative is done, wakes the staff out of their
+// waits so they leave on their own instead of being cancelled mid-read
+pthread_mutex_t shutdown_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t shutdown_cond = PTHREAD_COND_INITIALIZER;
+int shutdown_requested = 0;
+
 
 // Random number generator using Poisson distribution
 int get_random_number() {
-    // Creates a random device for non-deterministic random number generation
-    std::random_device rd;
-    // Initializes a random number generator using the random device
-    std::mt19937 generator(rd());
-
     // Lambda value for the Poisson distribution
     double lambda = 10000.234;
 
-    // Defines a Poisson distribution with the given lambda
-    std::poisson_distribution<int> poissonDist(lambda);
-
-    // Generates and returns a random number based on the Poisson distribution
-    return poissonDist(generator);
+    // Draws from the calling thread's stream, derived from --seed (sim_random.h)
+    return sim_poisson(sim_thread_rng(), lambda);
 }
 
 // Function to generate arrival delays (scaled down from the large Poisson values)
@@ -75,96 +92,228 @@ double get_current_time() {
     return difftime(time(NULL), start_time);
 }
 
+// Same clock in microseconds, for event timestamps (whole seconds match get_current_time)
+long long get_current_time_us() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start_time) * 1000000LL + now.tv_usec;
+}
+
+// Queue a finished unit for the logbook and return once it is committed.
+// The first unit to find no write under way becomes the committer and keeps
+// writing batches until the queue is empty; everyone else just waits.
+void commit_unit(int unit_id) {
+    pthread_mutex_lock(&commit_mutex);
+    commit_pending[commit_pending_count++] = unit_id;
+    long long ticket = ++commit_tickets;
+    
+    if (commit_writer_active) {
+        // A write is under way: ride along with the next one
+        while (commit_durable < ticket) {
+            pthread_cond_wait(&commit_done, &commit_mutex);
+        }
+        pthread_mutex_unlock(&commit_mutex);
+        return;
+    }
+    
+    commit_writer_active = 1;
+    while (commit_pending_count > 0) {
+        int count = commit_pending_count;
+        long long through = commit_tickets;
+        memcpy(commit_batch, commit_pending, count * sizeof(int));
+        commit_pending_count = 0;
+        pthread_mutex_unlock(&commit_mutex);
+        
+        // One logbook entry phase covers the whole batch
+        logbook_write_lock(&logbook);
+        sleep(y);
+        logbook_write_value(&logbook, &completed_operations, completed_operations + count);
+        for (int i = 0; i < count; i++) {
+            log_event(EV_UNIT_LOGGED, get_current_time_us(), commit_batch[i] + 1);
+        }
+        logbook_write_unlock(&logbook);
+        
+        pthread_mutex_lock(&commit_mutex);
+        commit_durable = through;
+        commit_writes++;
+        if (count > commit_max_batch) {
+            commit_max_batch = count;
+        }
+        pthread_cond_broadcast(&commit_done);
+    }
+    commit_writer_active = 0;
+    pthread_mutex_unlock(&commit_mutex);
+}
+
 // Operative thread function
 void* operative_thread(void* arg) {
     operative_t* op = (operative_t*)arg;
+    sim_random_bind_thread(op->id);
     
     // Random delay before arrival using Poisson distribution
     double delay = get_arrival_delay();
     sleep((int)delay);
     
-    double arrival_time = get_current_time();
-    printf("Operative %d has arrived at typewriting station at time %.0f\n", 
-           op->id, arrival_time);
+    log_event(EV_OPERATIVE_ARRIVED, get_current_time_us(), op->id);
     
-    // Wait for typewriting station
-    sem_wait(&station_semaphores[op->station_id]);
+    // Wait for a typewriting station picked by the dispatch policy
+    long long typing_start;
+    int station = station_acquire(&stations, op->station_id, &typing_start);
     
     // Document recreation phase
     sleep(x);
-    double completion_time = get_current_time();
-    printf("Operative %d has completed document recreation at time %.0f\n", 
-           op->id, completion_time);
+    log_event(EV_TYPING_DONE, get_current_time_us(), op->id);
     
     // Signal station availability
-    sem_post(&station_semaphores[op->station_id]);
+    station_release(&stations, station, typing_start);
     
-    // Update unit completion count
-    pthread_mutex_lock(&unit_mutex[op->unit_id]);
-    unit_completion_count[op->unit_id]++;
+    // Update unit completion count; only the member that completes the unit goes on
+    if (!sync_latch_count_down(&unit_latches[op->unit_id])) {
+        return NULL;
+    }
+    log_event(EV_UNIT_TYPING_DONE, get_current_time_us(), op->unit_id + 1);
     
-    // Check if unit is complete
-    if (unit_completion_count[op->unit_id] == M) {
-        printf("Unit %d has completed document recreation phase at time %.0f\n", 
-               op->unit_id + 1, get_current_time());
-        
-        // Leader (highest ID in unit) goes to logbook
-        // Wait for write access
-        sem_wait(&write_sem);
-        
-        // Logbook entry phase
-        sleep(y);
-        completed_operations++;
-        printf("Unit %d has completed intelligence distribution at time %.0f\n", 
-               op->unit_id + 1, get_current_time());
-        
-        // Release write access
-        sem_post(&write_sem);
+    if (group_commit) {
+        // Leader (last member to finish) hands the unit to the group commit
+        commit_unit(op->unit_id);
+        return NULL;
     }
     
-    pthread_mutex_unlock(&unit_mutex[op->unit_id]);
+    // Leader (last member to finish) goes to logbook
+    // Wait for write access
+    logbook_write_lock(&logbook);
+    
+    // Logbook entry phase
+    sleep(y);
+    logbook_write_value(&logbook, &completed_operations, completed_operations + 1);
+    log_event(EV_UNIT_LOGGED, get_current_time_us(), op->unit_id + 1);
+    
+    // Release write access
+    logbook_write_unlock(&logbook);
     
     return NULL;
 }
 
+// Sleep for the given seconds unless shutdown comes first; returns 1 on shutdown
+int staff_wait(double seconds) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    long long usec = (long long)(seconds * 1000000) + now.tv_usec;
+    struct timespec deadline;
+    deadline.tv_sec = now.tv_sec + usec / 1000000;
+    deadline.tv_nsec = (usec % 1000000) * 1000;
+
+    pthread_mutex_lock(&shutdown_mutex);
+    while (!shutdown_requested &&
+           pthread_cond_timedwait(&shutdown_cond, &shutdown_mutex, &deadline) == 0) {
+    }
+    int stopped = shutdown_requested;
+    pthread_mutex_unlock(&shutdown_mutex);
+    return stopped;
+}
+
 // Intelligence staff thread function
 void* staff_thread(void* arg) {
     staff_t* staff = (staff_t*)arg;
+    sim_random_bind_thread(N + staff->staff_id);
     
     while (1) {
         // Random delay between reads using Poisson distribution
         double delay = get_read_interval(staff->staff_id);
-        sleep((int)delay);
+        if (staff_wait((int)delay)) {
+            break;
+        }
         
         // Reader entry
-        pthread_mutex_lock(&reader_count_mutex);
-        reader_count++;
-        if (reader_count == 1) {
-            sem_wait(&write_sem); // First reader blocks writers
-        }
-        pthread_mutex_unlock(&reader_count_mutex);
+        logbook_read_lock(&logbook);
         
         // Reading logbook
-        double read_time = get_current_time();
-        printf("Intelligence Staff %d began reviewing logbook at time %.0f. Operations completed = %d\n", 
-               staff->staff_id, read_time, completed_operations);
+        log_event(EV_STAFF_REVIEW, get_current_time_us(), staff->staff_id,
+                  logbook_read_value(&logbook, &completed_operations));
         
-        // Simulate reading time
-        sleep(1);
+        // Simulate reading time, cut short by shutdown
+        int stopped = staff_wait(1);
         
-        // Reader exit
-        pthread_mutex_lock(&reader_count_mutex);
-        reader_count--;
-        if (reader_count == 0) {
-            sem_post(&write_sem); // Last reader allows writers
+        // Reader exit, always taken so the logbook is never left locked
+        logbook_read_unlock(&logbook);
+        if (stopped) {
+            break;
         }
-        pthread_mutex_unlock(&reader_count_mutex);
     }
     
     return NULL;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Optional binary event trace (read back with trace_format), logbook policy
+    // and station layout
+    int logbook_policy = LOGBOOK_READER_PREF;
+    int num_stations = 4, station_capacity = 1, station_dispatch = DISPATCH_MODULO;
+    int sync_backend = SYNC_POSIX;
+    int seeded = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            if (event_log_open(argv[i + 1]) != 0) {
+                printf("Error: Cannot open trace file %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+        if (strcmp(argv[i], "--logbook") == 0 && i + 1 < argc) {
+            logbook_policy = logbook_parse_policy(argv[i + 1]);
+            if (logbook_policy < 0) {
+                printf("Error: Unknown logbook policy %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            uint64_t seed;
+            if (sim_random_parse_seed(argv[i + 1], &seed) != 0) {
+                printf("Error: Invalid seed %s\n", argv[i + 1]);
+                return 1;
+            }
+            sim_random_seed(seed);
+            seeded = 1;
+        }
+        if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc) {
+            if (sim_random_record(argv[i + 1]) != 0) {
+                printf("Error: Cannot open draws file %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+        if (strcmp(argv[i], "--commit") == 0 && i + 1 < argc) {
+            group_commit = strcmp(argv[i + 1], "unit") != 0;
+        }
+        if (strcmp(argv[i], "--stations") == 0 && i + 1 < argc) {
+            num_stations = atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc) {
+            station_capacity = atoi(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "--sync") == 0 && i + 1 < argc) {
+            sync_backend = sync_parse_backend(argv[i + 1]);
+            if (sync_backend < 0) {
+                printf("Error: Unknown or unavailable sync backend %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+        if (strcmp(argv[i], "--dispatch") == 0 && i + 1 < argc) {
+            station_dispatch = station_parse_dispatch(argv[i + 1]);
+            if (station_dispatch < 0) {
+                printf("Error: Unknown dispatch policy %s\n", argv[i + 1]);
+                return 1;
+            }
+        }
+    }
+    if (num_stations <= 0 || station_capacity <= 0) {
+        printf("Error: Station count and capacity must be positive\n");
+        return 1;
+    }
+
+    // Same seed, same delays for every operative and staff member
+    if (!seeded) {
+        sim_random_seed_randomly();
+    }
+
     // Initialize start time
     start_time = time(NULL);
     
@@ -189,22 +338,19 @@ int main() {
     int c = N / M;  //number of units
     
     // Initialize synchronization primitives
-    station_semaphores = (sem_t*)malloc(4 * sizeof(sem_t));
-    unit_mutex = (pthread_mutex_t*)malloc(c * sizeof(pthread_mutex_t));
-    unit_completion_count = (int*)calloc(c, sizeof(int));
+    unit_latches = (SyncLatch*)malloc(c * sizeof(SyncLatch));
+    commit_pending = (int*)malloc(c * sizeof(int));
+    commit_batch = (int*)malloc(c * sizeof(int));
     
     // Initialize semaphores and mutexes
-    for (int i = 0; i < 4; i++) {
-        sem_init(&station_semaphores[i], 0, 1); // Each station can handle 1 operative
-    }
+    stations_init(&stations, num_stations, station_capacity, station_dispatch, sync_backend);
     
     for (int i = 0; i < c; i++) {
-        pthread_mutex_init(&unit_mutex[i], NULL);
+        sync_latch_init(&unit_latches[i], sync_backend, M);
     }
     
     pthread_mutex_init(&logbook_mutex, NULL);
-    pthread_mutex_init(&reader_count_mutex, NULL);
-    sem_init(&write_sem, 0, 1);
+    logbook_init(&logbook, logbook_policy);
     
     // Create operative threads
     pthread_t* operative_threads = (pthread_t*)malloc(N * sizeof(pthread_t));
@@ -213,7 +359,7 @@ int main() {
     for (int i = 0; i < N; i++) {
         operatives[i].id = i + 1;
         operatives[i].unit_id = i / M;
-        operatives[i].station_id = (i % 4); // Station assignment: (ID mod 4)
+        operatives[i].station_id = (i % num_stations); // Home station: (ID mod station count)
         
         pthread_create(&operative_threads[i], NULL, operative_thread, &operatives[i]);
     }
@@ -235,33 +381,43 @@ int main() {
         pthread_join(operative_threads[i], NULL);
     }
     
-    // give some time for final staff readings
-    sleep(5);
-
-    // cancel staff threads (they run indefinitely)
-    pthread_cancel(staff_threads[0]);
-    pthread_cancel(staff_threads[1]);
+    // every unit is logged: wake the staff and wait for them to leave
+    pthread_mutex_lock(&shutdown_mutex);
+    shutdown_requested = 1;
+    pthread_cond_broadcast(&shutdown_cond);
+    pthread_mutex_unlock(&shutdown_mutex);
+    pthread_join(staff_threads[0], NULL);
+    pthread_join(staff_threads[1], NULL);
     
     // Cleanup
-    for (int i = 0; i < 4; i++) {
-        sem_destroy(&station_semaphores[i]);
-    }
-    
     for (int i = 0; i < c; i++) {
-        pthread_mutex_destroy(&unit_mutex[i]);
+        sync_latch_destroy(&unit_latches[i]);
     }
     
     pthread_mutex_destroy(&logbook_mutex);
-    pthread_mutex_destroy(&reader_count_mutex);
-    sem_destroy(&write_sem);
+    // Station and logbook metrics go to stderr
+    long long elapsed = get_current_time_us();
+    sim_random_report(stderr);
+    logbook_report(&logbook, elapsed, stderr);
+    resource_report_header(stderr);
+    stations_report(&stations, elapsed, stderr);
+    resource_report_row(stderr, "logbook", &logbook.write_stats, elapsed);
+    if (group_commit) {
+        fprintf(stderr, "Logbook commits: %d writes for %d units, largest batch %d\n",
+                commit_writes, completed_operations, commit_max_batch);
+    }
+    logbook_destroy(&logbook);
+    stations_destroy(&stations);
     
-    free(station_semaphores);
-    free(unit_mutex);
-    free(unit_completion_count);
+    free(unit_latches);
+    free(commit_pending);
+    free(commit_batch);
     free(operative_threads);
     free(operatives);
     
-    printf("All operations completed successfully!\n");
+    log_event(EV_ALL_DONE, get_current_time_us());
+    event_log_close();
+    sim_random_close();
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include<stdio.h>
+#include<pthread.h>
+#include<unistd.h>
+#include "ring_queue.h"
+using namespace std;
+
+
+//lock-free ring of 5 items (rounded up to 8): push sleeps while it is full,
+//pop sleeps while it is empty, no mutex or semaphore needed
+SpscRing<int> q;
+
+
+void init_queue()
+{
+	spsc_init(&q,5);
+}
+
+void * ProducerFunc(void * arg)
+{
+	printf("%s\n",(char*)arg);
+	int i;
+	for(i=1;i<=10;i++)
+	{
+		sleep(1);
+		spsc_push(&q,i);
+		printf("producer produced item %d\n",i);
+	}
+	return NULL;
+}
+
+void * ConsumerFunc(void * arg)
+{
+	printf("%s\n",(char*)arg);
+	int i;
+	for(i=1;i<=10;i++)
+	{
+		int item;
+		spsc_pop(&q,&item);
+		sleep(1);
+		printf("consumer consumed item %d\n",item);
+	}
+	return NULL;
+}
+
+
+
+
+
+int main(void)
+{
+	pthread_t thread1;
+	pthread_t thread2;
+
+	init_queue();
+
+	const char * message1 = "i am producer";
+	const char * message2 = "i am consumer";
+
+	pthread_create(&thread1,NULL,ProducerFunc,(void*)message1 );
+	pthread_create(&thread2,NULL,ConsumerFunc,(void*)message2 );
+
+
+	pthread_join(thread1,NULL);
+	pthread_join(thread2,NULL);
+	spsc_destroy(&q);
+	return 0;
+}
@@ -0,0 +1,308 @@
+/*
+  Random number benchmark: the std::mt19937 + std::poisson_distribution
+  draws the simulations are built on, against xoshiro.h.
+
+  Every method fills an array of SAMPLES numbers, in blocks of 4096, on
+  each of T threads (thread i on stream i). Methods per distribution:
+
+    poisson      mt19937    std::mt19937 + std::poisson_distribution, as in
+                            poisson_random_number_generator.cpp
+                 splitmix   SimRng (sim_random.h) + std::poisson_distribution,
+                            what the simulations draw from now
+                 xoshiro    scalar Xoshiro256 + std::poisson_distribution
+                 batch      xoshiro_fill_poisson
+    exponential  mt19937    std::mt19937 + std::exponential_distribution
+                 xoshiro    scalar Xoshiro256 + std::exponential_distribution
+                 batch      xoshiro_fill_exponential
+    uniform      mt19937    std::mt19937_64 raw 64-bit outputs
+                 xoshiro    scalar xoshiro_next
+                 batch      xoshiro_fill_u64
+    small        mt19937    std::poisson_distribution(lambda) % 21, the
+                            0..20 s delays of peaky_blinders.cpp
+                 xoshiro    xoshiro_below(21)
+
+  One CSV row per run:
+
+    distribution,method,lambda,threads,samples,rep,wall_s,samples_per_s,
+    speedup,mean,variance
+
+  samples is per thread, samples_per_s over all threads, speedup against
+  mt19937 on the same distribution, lambda and thread count. mean and
+  variance are over thread 0's samples, as a sanity check (Poisson: both
+  lambda; exponential with rate 1 / lambda: lambda and lambda^2).
+
+  Compilation:
+    g++ -O2 -pthread random_bench.cpp -o random_bench
+    (add -mavx2 to run the batch lanes in one AVX2 register)
+
+  Usage:
+    ./random_bench [--lambda LIST] [--threads LIST] [--samples N]
+                   [--reps K] [--out FILE]
+
+    LIST is comma separated (lambdas may have decimals). Defaults:
+    --lambda 10000.234,1000.234,4 --threads 1 --samples 4000000 --reps 3,
+    CSV on stdout. uniform runs once, at the first lambda.
+*/
+
+#include <pthread.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "bench_util.h"
+#include "sim_random.h"
+#include "xoshiro.h"
+
+#define BLOCK 4096 // samples per fill call
+
+enum { DIST_POISSON, DIST_EXPONENTIAL, DIST_UNIFORM, DIST_SMALL };
+static const char *dist_names[] = {"poisson", "exponential", "uniform",
+                                   "small"};
+enum { METHOD_MT19937, METHOD_SPLITMIX, METHOD_XOSHIRO, METHOD_BATCH };
+static const char *method_names[] = {"mt19937", "splitmix", "xoshiro",
+                                     "batch"};
+
+typedef struct {
+  int dist, method;
+  double lambda;
+  long long samples;
+  unsigned stream;
+  double mean, variance; // of this thread's samples
+} BenchJob;
+
+// Plain sums, cheap enough not to hide the generators' cost
+typedef struct {
+  long long n;
+  double sum, sum_sq;
+} Moments;
+
+template <typename Fill> static Moments run_blocks(long long samples, Fill fill) {
+  std::vector<double> block(BLOCK);
+  Moments m = {0, 0, 0};
+  for (long long done = 0; done < samples; done += BLOCK) {
+    int n = samples - done < BLOCK ? (int)(samples - done) : BLOCK;
+    fill(block.data(), n);
+    for (int i = 0; i < n; i++) {
+      m.sum += block[i];
+      m.sum_sq += block[i] * block[i];
+    }
+    m.n += n;
+  }
+  return m;
+}
+
+static void *bench_thread(void *arg) {
+  BenchJob *job = (BenchJob *)arg;
+  uint64_t seed = 12345;
+  double lambda = job->lambda;
+
+  std::mt19937 mt(seed + job->stream);
+  std::mt19937_64 mt64(seed + job->stream);
+  SimRng split;
+  sim_rng_init_seeded(&split, seed, job->stream);
+  Xoshiro256 xo = xoshiro_stream(seed, job->stream);
+  XoshiroBatch batch;
+  xoshiro_batch_init(&batch, &xo);
+  std::vector<int> ints(BLOCK);
+  std::vector<uint64_t> words(BLOCK);
+
+  std::poisson_distribution<int> poisson(lambda);
+  std::exponential_distribution<double> expo(1.0 / lambda);
+  Moments m;
+
+  switch (job->dist * 4 + job->method) {
+  case DIST_POISSON * 4 + METHOD_MT19937:
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      for (int i = 0; i < n; i++)
+        out[i] = poisson(mt);
+    });
+    break;
+  case DIST_POISSON * 4 + METHOD_SPLITMIX:
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      for (int i = 0; i < n; i++)
+        out[i] = poisson(split);
+    });
+    break;
+  case DIST_POISSON * 4 + METHOD_XOSHIRO:
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      for (int i = 0; i < n; i++)
+        out[i] = poisson(xo);
+    });
+    break;
+  case DIST_POISSON * 4 + METHOD_BATCH:
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      xoshiro_fill_poisson(&batch, ints.data(), n, lambda);
+      for (int i = 0; i < n; i++)
+        out[i] = ints[i];
+    });
+    break;
+  case DIST_EXPONENTIAL * 4 + METHOD_MT19937:
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      for (int i = 0; i < n; i++)
+        out[i] = expo(mt);
+    });
+    break;
+  case DIST_EXPONENTIAL * 4 + METHOD_XOSHIRO:
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      for (int i = 0; i < n; i++)
+        out[i] = expo(xo);
+    });
+    break;
+  case DIST_EXPONENTIAL * 4 + METHOD_BATCH:
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      xoshiro_fill_exponential(&batch, out, n, 1.0 / lambda);
+    });
+    break;
+  // uniform: the top 53 bits as a fraction, so the moments mean something
+  case DIST_UNIFORM * 4 + METHOD_MT19937:
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      for (int i = 0; i < n; i++)
+        out[i] = (mt64() >> 11) * 0x1.0p-53;
+    });
+    break;
+  case DIST_UNIFORM * 4 + METHOD_XOSHIRO:
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      for (int i = 0; i < n; i++)
+        out[i] = (xoshiro_next(&xo) >> 11) * 0x1.0p-53;
+    });
+    break;
+  case DIST_UNIFORM * 4 + METHOD_BATCH:
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      xoshiro_fill_u64(&batch, words.data(), n);
+      for (int i = 0; i < n; i++)
+        out[i] = (words[i] >> 11) * 0x1.0p-53;
+    });
+    break;
+  case DIST_SMALL * 4 + METHOD_MT19937:
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      for (int i = 0; i < n; i++)
+        out[i] = poisson(mt) % 21;
+    });
+    break;
+  default: // DIST_SMALL, METHOD_XOSHIRO
+    m = run_blocks(job->samples, [&](double *out, int n) {
+      for (int i = 0; i < n; i++)
+        out[i] = xoshiro_below(&xo, 21);
+    });
+  }
+
+  job->mean = m.sum / m.n;
+  job->variance = m.n > 1 ? (m.sum_sq - m.sum * job->mean) / (m.n - 1) : 0;
+  return NULL;
+}
+
+// Methods run for a distribution; the first is the speedup baseline
+static std::vector<int> methods_for(int dist) {
+  switch (dist) {
+  case DIST_POISSON:
+    return {METHOD_MT19937, METHOD_SPLITMIX, METHOD_XOSHIRO, METHOD_BATCH};
+  case DIST_SMALL:
+    return {METHOD_MT19937, METHOD_XOSHIRO};
+  default:
+    return {METHOD_MT19937, METHOD_XOSHIRO, METHOD_BATCH};
+  }
+}
+
+static std::vector<double> parse_double_list(const char *text) {
+  std::vector<double> values;
+  const char *p = text;
+  while (*p) {
+    values.push_back(atof(p));
+    p = strchr(p, ',');
+    if (!p)
+      break;
+    p++;
+  }
+  return values;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<double> lambdas = {10000.234, 1000.234, 4};
+  std::vector<int> thread_counts = {1};
+  long long samples = 4000000;
+  int reps = 3;
+  const char *out_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (strcmp(arg, "--lambda") == 0)
+      lambdas = parse_double_list(value);
+    else if (strcmp(arg, "--threads") == 0)
+      thread_counts = parse_list(value);
+    else if (strcmp(arg, "--samples") == 0)
+      samples = atoll(value);
+    else if (strcmp(arg, "--reps") == 0)
+      reps = atoi(value);
+    else if (strcmp(arg, "--out") == 0)
+      out_path = value;
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+  if (samples <= 0 || reps <= 0) {
+    fprintf(stderr, "Samples and reps must be positive\n");
+    return 1;
+  }
+  for (double lambda : lambdas)
+    if (!(lambda > 0) || lambda > 1e9) {
+      fprintf(stderr, "Lambdas must be in (0, 1e9]\n");
+      return 1;
+    }
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Error opening %s\n", out_path);
+    return 1;
+  }
+  fprintf(out, "distribution,method,lambda,threads,samples,rep,wall_s,"
+               "samples_per_s,speedup,mean,variance\n");
+
+  for (int dist = DIST_POISSON; dist <= DIST_SMALL; dist++)
+    for (double lambda : lambdas)
+      for (int threads : thread_counts) {
+        // uniform does not depend on lambda: run it once
+        if (threads <= 0 || (dist == DIST_UNIFORM && lambda != lambdas[0]))
+          continue;
+        double baseline = 0;
+        for (int method : methods_for(dist))
+          for (int rep = 0; rep < reps; rep++) {
+            std::vector<BenchJob> jobs(threads);
+            std::vector<pthread_t> tids(threads);
+            double start = now_s();
+            for (int i = 0; i < threads; i++) {
+              jobs[i].dist = dist;
+              jobs[i].method = method;
+              jobs[i].lambda = lambda;
+              jobs[i].samples = samples;
+              jobs[i].stream = i;
+              pthread_create(&tids[i], NULL, bench_thread, &jobs[i]);
+            }
+            for (pthread_t t : tids)
+              pthread_join(t, NULL);
+            double wall = now_s() - start;
+            double rate = wall > 0 ? samples * threads / wall : 0;
+            if (method == METHOD_MT19937 && rep == 0)
+              baseline = rate;
+
+            fprintf(out, "%s,%s,%g,%d,%lld,%d,%.6f,%.1f,%.2f,%.4f,%.4f\n",
+                    dist_names[dist], method_names[method], lambda, threads,
+                    samples, rep, wall, rate,
+                    baseline > 0 ? rate / baseline : 0.0, jobs[0].mean,
+                    jobs[0].variance);
+            fflush(out);
+          }
+      }
+
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
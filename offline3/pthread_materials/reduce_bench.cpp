@@ -0,0 +1,200 @@
+/*
+  Parallel reduction benchmark: simple_sum_calculation.cpp against
+  parallel_reduce.h.
+
+  For each workload and thread count from 1 up to every online CPU, runs:
+    simple   - simple_sum_calculation's scheme, copied as is: a static split,
+               a packed ThreadData array whose sum every thread updates in
+               its loop, an int loop index
+    static   - parallel_reduce with stealing off: padded slots, local
+               accumulators, the vectorized kernel
+    steal    - parallel_reduce with work stealing
+
+  Workloads:
+    sum      - 1 + 2 + ... + N, the running example (every index costs the
+               same)
+    skewed   - the same sum, but index i also spins through 1 + 32 i / N
+               rounds of a hash first, so the last shares cost far more
+               than the first (simple uses a scalar loop over the same
+               per-index work)
+
+  One CSV row per run:
+
+    workload,method,threads,N,rep,wall_s,speedup,ok
+
+  speedup is against simple at the first thread count (1 unless --threads
+  says otherwise) on the same workload, ok whether the result matched the
+  closed form (sum) or a one-thread run (skewed).
+
+  Compilation:
+    g++ -O2 -pthread reduce_bench.cpp -o reduce_bench
+
+  Usage:
+    ./reduce_bench [--threads LIST] [--n N] [--reps K] [--out FILE]
+
+    LIST is comma separated. Defaults: 1, 2, 4, ... up to the online CPU
+    count (and the count itself), --n 1000000000 for sum (a fiftieth of it
+    for skewed), --reps 3, CSV on stdout.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "bench_util.h"
+#include "parallel_reduce.h"
+
+enum { WORK_SUM, WORK_SKEWED };
+static const char *workload_names[] = {"sum", "skewed"};
+static const char *method_names[] = {"simple", "static", "steal"};
+
+// simple_sum_calculation.cpp, with the kernel picked per workload
+class ThreadData {
+public:
+  long start;
+  long end;
+  long long sum;
+  int workload;
+  long n;
+};
+
+static long long skewed_value(long long i, long long n) {
+  unsigned long long h = (unsigned long long)i;
+  long long rounds = 1 + 32 * i / n;
+  for (long long r = 0; r < rounds; r++)
+    h = h * 6364136223846793005ULL + 1442695040888963407ULL;
+  return i + (long long)(h >> 63);
+}
+
+static void *simple_compute_sum(void *arg) {
+  ThreadData *data = (ThreadData *)arg;
+  data->sum = 0;
+  for (int i = data->start; i <= data->end; i++) {
+    if (data->workload == WORK_SUM)
+      data->sum += i;
+    else
+      data->sum += skewed_value(i, data->n);
+  }
+  return NULL;
+}
+
+static long long simple_sum(long n, int m, int workload) {
+  std::vector<pthread_t> threads(m);
+  std::vector<ThreadData> data(m);
+  long long sum = 0;
+  for (int i = 0; i < m; i++) {
+    data[i].start = i * n / m + 1;
+    data[i].end = (i + 1) * n / m;
+    data[i].workload = workload;
+    data[i].n = n;
+    pthread_create(&threads[i], NULL, simple_compute_sum, &data[i]);
+  }
+  for (int i = 0; i < m; i++) {
+    pthread_join(threads[i], NULL);
+    sum += data[i].sum;
+  }
+  return sum;
+}
+
+static long long reduce_sum(long long n, int threads, int steal,
+                            int workload) {
+  ReduceOptions opts = reduce_default_options();
+  opts.threads = threads;
+  opts.steal = steal;
+  auto add = [](long long x, long long y) { return x + y; };
+
+  if (workload == WORK_SUM)
+    return parallel_reduce(1, n + 1, 0LL, reduce_sum_indices, add, opts);
+  return parallel_reduce(
+      1, n + 1, 0LL,
+      [n](long long b, long long e) {
+        long long sum = 0;
+        for (long long i = b; i < e; i++)
+          sum += skewed_value(i, n);
+        return sum;
+      },
+      add, opts);
+}
+
+int main(int argc, char *argv[]) {
+  int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpus <= 0)
+    cpus = 1;
+  std::vector<int> thread_counts;
+  for (int t = 1; t < cpus; t *= 2)
+    thread_counts.push_back(t);
+  thread_counts.push_back(cpus);
+  long long n = 1000000000;
+  int reps = 3;
+  const char *out_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (strcmp(arg, "--threads") == 0)
+      thread_counts = parse_list(value);
+    else if (strcmp(arg, "--n") == 0)
+      n = atoll(value);
+    else if (strcmp(arg, "--reps") == 0)
+      reps = atoi(value);
+    else if (strcmp(arg, "--out") == 0)
+      out_path = value;
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+  // simple's int loop index caps N
+  if (n <= 0 || n > 2147483647 || reps <= 0) {
+    fprintf(stderr, "N must be in 1..2147483647 and reps positive\n");
+    return 1;
+  }
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Error opening %s\n", out_path);
+    return 1;
+  }
+  fprintf(out, "workload,method,threads,N,rep,wall_s,speedup,ok\n");
+
+  for (int workload = WORK_SUM; workload <= WORK_SKEWED; workload++) {
+    long long wn = workload == WORK_SUM ? n : n / 50;
+    long long expected = workload == WORK_SUM
+                             ? wn * (wn + 1) / 2
+                             : reduce_sum(wn, 1, 0, workload);
+    double baseline = 0;
+
+    for (int threads : thread_counts) {
+      if (threads <= 0)
+        continue;
+      for (int method = 0; method < 3; method++)
+        for (int rep = 0; rep < reps; rep++) {
+          double start = now_s();
+          long long result =
+              method == 0 ? simple_sum((long)wn, threads, workload)
+                          : reduce_sum(wn, threads, method == 2, workload);
+          double wall = now_s() - start;
+          if (method == 0 && threads == thread_counts[0] && rep == 0)
+            baseline = wall;
+
+          fprintf(out, "%s,%s,%d,%lld,%d,%.6f,%.2f,%d\n",
+                  workload_names[workload], method_names[method], threads, wn,
+                  rep, wall, wall > 0 ? baseline / wall : 0.0,
+                  result == expected);
+          fflush(out);
+        }
+    }
+  }
+
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
@@ -0,0 +1,263 @@
+/*
+  Producer/consumer queue benchmark: prod_cons_with_mutex.cpp's queue
+  against the rings in ring_queue.h.
+
+  P producer threads push ITEMS integers in total and C consumer threads
+  pop them, with no sleeps or printing, through one of:
+    mutex  - prod_cons_with_mutex.cpp's scheme: std::queue<int> guarded by
+             a pthread mutex, empty/full counting semaphores (sem_t)
+    spsc   - SpscRing (only run with one producer and one consumer)
+    mpmc   - MpmcRing
+
+  One CSV row per run:
+
+    queue,producers,consumers,capacity,items,rep,wall_s,items_per_s,
+    push_waits,pop_waits,ok,user_s,sys_s,vol_ctx_switches,
+    invol_ctx_switches
+
+  push_waits/pop_waits count futex sleeps in the rings (empty for mutex),
+  ok whether the consumers' checksum matched what the producers pushed.
+  CPU time and context switches are getrusage deltas over the run.
+
+  Compilation:
+    g++ -O2 -pthread ring_bench.cpp -o ring_bench
+
+  Usage:
+    ./ring_bench [--queue LIST] [--producers LIST] [--consumers LIST]
+                 [--capacity N] [--items N] [--reps K] [--out FILE]
+
+    LIST is comma separated. Defaults: --queue mutex,spsc,mpmc
+    --producers 1,2,4 --consumers 1,2,4 --capacity 1024 --items 2000000
+    --reps 1, CSV on stdout. prod_cons_with_mutex.cpp itself holds 5 items
+    (--capacity 5; rings round up to a power of two).
+*/
+
+#include <pthread.h>
+#include <queue>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+#include <time.h>
+#include <vector>
+
+#include "bench_util.h"
+#include "ring_queue.h"
+
+enum { QUEUE_MUTEX, QUEUE_SPSC, QUEUE_MPMC };
+static const char *queue_names[] = {"mutex", "spsc", "mpmc"};
+
+typedef struct {
+  int kind;
+  // mutex
+  sem_t empty_sem;
+  sem_t full;
+  std::queue<int> q;
+  pthread_mutex_t lock;
+  // rings
+  SpscRing<int> spsc;
+  MpmcRing<int> mpmc;
+} BenchQueue;
+
+typedef struct {
+  BenchQueue *queue;
+  long long first, count; // items first .. first + count - 1
+  long long checksum;     // consumers: sum of what they popped
+} BenchSide;
+
+static void bench_push(BenchQueue *bq, int item) {
+  switch (bq->kind) {
+  case QUEUE_MUTEX:
+    sem_wait(&bq->empty_sem);
+    pthread_mutex_lock(&bq->lock);
+    bq->q.push(item);
+    pthread_mutex_unlock(&bq->lock);
+    sem_post(&bq->full);
+    break;
+  case QUEUE_SPSC:
+    spsc_push(&bq->spsc, item);
+    break;
+  default:
+    mpmc_push(&bq->mpmc, item);
+  }
+}
+
+static int bench_pop(BenchQueue *bq) {
+  int item;
+  switch (bq->kind) {
+  case QUEUE_MUTEX:
+    sem_wait(&bq->full);
+    pthread_mutex_lock(&bq->lock);
+    item = bq->q.front();
+    bq->q.pop();
+    pthread_mutex_unlock(&bq->lock);
+    sem_post(&bq->empty_sem);
+    break;
+  case QUEUE_SPSC:
+    spsc_pop(&bq->spsc, &item);
+    break;
+  default:
+    mpmc_pop(&bq->mpmc, &item);
+  }
+  return item;
+}
+
+static void *bench_producer(void *arg) {
+  BenchSide *side = (BenchSide *)arg;
+  for (long long i = 0; i < side->count; i++)
+    bench_push(side->queue, (int)(side->first + i));
+  return NULL;
+}
+
+static void *bench_consumer(void *arg) {
+  BenchSide *side = (BenchSide *)arg;
+  long long sum = 0;
+  for (long long i = 0; i < side->count; i++)
+    sum += bench_pop(side->queue);
+  side->checksum = sum;
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<int> queues = {QUEUE_MUTEX, QUEUE_SPSC, QUEUE_MPMC};
+  std::vector<int> producer_counts = {1, 2, 4};
+  std::vector<int> consumer_counts = {1, 2, 4};
+  int capacity = 1024, reps = 1;
+  long long items = 2000000;
+  const char *out_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (strcmp(arg, "--queue") == 0) {
+      queues.clear();
+      std::string name;
+      for (const char *p = value;; p++) {
+        if (*p == ',' || *p == '\0') {
+          int kind = -1;
+          for (int k = 0; k < 3; k++)
+            if (name == queue_names[k])
+              kind = k;
+          if (kind < 0) {
+            fprintf(stderr, "Unknown queue %s\n", name.c_str());
+            return 1;
+          }
+          queues.push_back(kind);
+          name.clear();
+          if (*p == '\0')
+            break;
+        } else {
+          name += *p;
+        }
+      }
+    } else if (strcmp(arg, "--producers") == 0)
+      producer_counts = parse_list(value);
+    else if (strcmp(arg, "--consumers") == 0)
+      consumer_counts = parse_list(value);
+    else if (strcmp(arg, "--capacity") == 0)
+      capacity = atoi(value);
+    else if (strcmp(arg, "--items") == 0)
+      items = atoll(value);
+    else if (strcmp(arg, "--reps") == 0)
+      reps = atoi(value);
+    else if (strcmp(arg, "--out") == 0)
+      out_path = value;
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+  // Items are pushed as int
+  if (capacity <= 0 || items <= 0 || items > 2147483647 || reps <= 0) {
+    fprintf(stderr, "Capacity, items (up to 2^31 - 1) and reps must be "
+                    "positive\n");
+    return 1;
+  }
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Error opening %s\n", out_path);
+    return 1;
+  }
+  fprintf(out, "queue,producers,consumers,capacity,items,rep,wall_s,"
+               "items_per_s,push_waits,pop_waits,ok,user_s,sys_s,"
+               "vol_ctx_switches,invol_ctx_switches\n");
+
+  for (int producers : producer_counts)
+    for (int consumers : consumer_counts) {
+      if (producers <= 0 || consumers <= 0)
+        continue;
+      for (int kind : queues) {
+        if (kind == QUEUE_SPSC && (producers != 1 || consumers != 1))
+          continue;
+        for (int rep = 0; rep < reps; rep++) {
+          BenchQueue *bq = new BenchQueue();
+          bq->kind = kind;
+          sem_init(&bq->empty_sem, 0, capacity);
+          sem_init(&bq->full, 0, 0);
+          pthread_mutex_init(&bq->lock, NULL);
+          spsc_init(&bq->spsc, capacity);
+          mpmc_init(&bq->mpmc, capacity);
+
+          std::vector<BenchSide> prod(producers), cons(consumers);
+          split(prod, bq, items);
+          split(cons, bq, items);
+          std::vector<pthread_t> tids(producers + consumers);
+
+          struct rusage before, after;
+          getrusage(RUSAGE_SELF, &before);
+          long long start = now_ns();
+          for (int i = 0; i < consumers; i++)
+            pthread_create(&tids[i], NULL, bench_consumer, &cons[i]);
+          for (int i = 0; i < producers; i++)
+            pthread_create(&tids[consumers + i], NULL, bench_producer,
+                           &prod[i]);
+          for (pthread_t t : tids)
+            pthread_join(t, NULL);
+          double wall = (now_ns() - start) / 1e9;
+          getrusage(RUSAGE_SELF, &after);
+
+          long long checksum = 0;
+          for (BenchSide &c : cons)
+            checksum += c.checksum;
+          unsigned long long push_waits =
+              kind == QUEUE_SPSC ? bq->spsc.push_waits : bq->mpmc.push_waits;
+          unsigned long long pop_waits =
+              kind == QUEUE_SPSC ? bq->spsc.pop_waits : bq->mpmc.pop_waits;
+
+          if (kind == QUEUE_MUTEX)
+            fprintf(out, "%s,%d,%d,%d,%lld,%d,%.6f,%.1f,,,", queue_names[kind],
+                    producers, consumers, capacity, items, rep, wall,
+                    items / wall);
+          else
+            fprintf(out, "%s,%d,%d,%d,%lld,%d,%.6f,%.1f,%llu,%llu,",
+                    queue_names[kind], producers, consumers, capacity, items,
+                    rep, wall, items / wall, push_waits, pop_waits);
+          fprintf(out, "%d,%.6f,%.6f,%ld,%ld\n",
+                  checksum == items * (items - 1) / 2,
+                  tv_s(after.ru_utime) - tv_s(before.ru_utime),
+                  tv_s(after.ru_stime) - tv_s(before.ru_stime),
+                  after.ru_nvcsw - before.ru_nvcsw,
+                  after.ru_nivcsw - before.ru_nivcsw);
+          fflush(out);
+
+          spsc_destroy(&bq->spsc);
+          mpmc_destroy(&bq->mpmc);
+          pthread_mutex_destroy(&bq->lock);
+          sem_destroy(&bq->empty_sem);
+          sem_destroy(&bq->full);
+          delete bq;
+        }
+      }
+    }
+
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
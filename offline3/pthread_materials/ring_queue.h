@@ -0,0 +1,336 @@
+/*
+  Bounded lock-free ring buffers for producer/consumer code.
+
+  prod_cons_with_mutex.cpp pays four synchronization operations per item
+  (two semaphores, lock, unlock) around a std::queue. The rings here need
+  one atomic store (SPSC) or one compare-and-swap (MPMC) per item, and a
+  syscall only when a side actually has to sleep:
+
+    SpscRing  one producer, one consumer. head and tail live on separate
+              cache lines and each side keeps a cached copy of the other's
+              index, so the shared lines move only when the cached view
+              runs out.
+    MpmcRing  any number of producers and consumers (the bounded queue
+              with a sequence number per cell: a cell's sequence says
+              whether it is free for the producer claiming that position
+              or full for the consumer claiming it).
+
+  Both block when empty or full: a waiter spins briefly, then announces
+  itself and sleeps in futex_wait (futex.h) on the other side's index, so
+  an uncontended push or pop never enters the kernel. SPSC has at most one
+  sleeper per side: it raises a flag that the side moving the index takes
+  down when it wakes it, so a burst of pushes wakes a sleeping consumer
+  once, not once per item. MPMC sleepers are counted instead (a shared
+  flag taken down by one wake would hide the others), along with the wakes
+  that reached a sleeper that has not run yet: a push or pop wakes one
+  more only while there are more waiters than such wakes, so a burst still
+  costs one wake per sleeper rather than one per item.
+
+  Capacities are rounded up to a power of two. Positions are 32-bit and
+  wrap; only their differences are ever compared.
+*/
+
+#ifndef RING_QUEUE_H
+#define RING_QUEUE_H
+
+#include <sched.h>
+#include <stdlib.h>
+
+#include "futex.h"
+
+#define RING_SPINS 64 // failed tries before a waiter goes to sleep
+
+static inline void ring_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+static inline unsigned ring_round_up(unsigned capacity) {
+  unsigned size = 2;
+  while (size < capacity)
+    size <<= 1;
+  return size;
+}
+
+// Single producer, single consumer
+
+template <typename T> struct SpscRing {
+  alignas(64) unsigned head; // next position to pop, moved by the consumer
+  unsigned cached_tail;      // consumer's last look at tail
+  unsigned long long pop_waits;
+
+  alignas(64) unsigned tail; // next position to push, moved by the producer
+  unsigned cached_head;      // producer's last look at head
+  unsigned long long push_waits;
+
+  alignas(64) int consumer_waiting; // raised before a futex sleep
+  int producer_waiting;
+
+  alignas(64) unsigned mask;
+  T *slots;
+};
+
+template <typename T>
+static inline void spsc_init(SpscRing<T> *q, unsigned capacity) {
+  q->head = q->tail = 0;
+  q->cached_head = q->cached_tail = 0;
+  q->pop_waits = q->push_waits = 0;
+  q->consumer_waiting = q->producer_waiting = 0;
+  q->mask = ring_round_up(capacity) - 1;
+  q->slots = new T[q->mask + 1];
+}
+
+template <typename T> static inline void spsc_destroy(SpscRing<T> *q) {
+  delete[] q->slots;
+}
+
+/**
+ * Push without blocking (producer only).
+ * @return 1 if the item went in, 0 if the ring is full.
+ */
+template <typename T>
+static inline int spsc_try_push(SpscRing<T> *q, const T &item) {
+  unsigned tail = q->tail;
+  if (tail - q->cached_head > q->mask) {
+    q->cached_head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    if (tail - q->cached_head > q->mask)
+      return 0;
+  }
+  q->slots[tail & q->mask] = item;
+  __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+
+  // Pairs with the fence in spsc_pop: either it sees the new tail or we see
+  // it waiting
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&q->consumer_waiting, __ATOMIC_RELAXED) &&
+      __atomic_exchange_n(&q->consumer_waiting, 0, __ATOMIC_RELAXED))
+    futex_wake((int *)&q->tail, 1);
+  return 1;
+}
+
+/**
+ * Pop without blocking (consumer only).
+ * @return 1 with *item set, 0 if the ring is empty.
+ */
+template <typename T> static inline int spsc_try_pop(SpscRing<T> *q, T *item) {
+  unsigned head = q->head;
+  if (head == q->cached_tail) {
+    q->cached_tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    if (head == q->cached_tail)
+      return 0;
+  }
+  *item = q->slots[head & q->mask];
+  __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&q->producer_waiting, __ATOMIC_RELAXED) &&
+      __atomic_exchange_n(&q->producer_waiting, 0, __ATOMIC_RELAXED))
+    futex_wake((int *)&q->head, 1);
+  return 1;
+}
+
+template <typename T>
+static inline void spsc_push(SpscRing<T> *q, const T &item) {
+  for (int i = 0; i < RING_SPINS; i++) {
+    if (spsc_try_push(q, item))
+      return;
+    ring_relax();
+  }
+  while (!spsc_try_push(q, item)) {
+    __atomic_store_n(&q->producer_waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    unsigned head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    if (q->tail - head > q->mask) {
+      q->push_waits++;
+      futex_wait((int *)&q->head, (int)head);
+    }
+  }
+}
+
+template <typename T> static inline void spsc_pop(SpscRing<T> *q, T *item) {
+  for (int i = 0; i < RING_SPINS; i++) {
+    if (spsc_try_pop(q, item))
+      return;
+    ring_relax();
+  }
+  while (!spsc_try_pop(q, item)) {
+    __atomic_store_n(&q->consumer_waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    unsigned tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    if (tail == q->head) {
+      q->pop_waits++;
+      futex_wait((int *)&q->tail, (int)tail);
+    }
+  }
+}
+
+// Multiple producers, multiple consumers
+
+template <typename T> struct MpmcCell {
+  unsigned seq; // == position: free to fill; == position + 1: full
+  T value;
+};
+
+/*
+  MPMC sleep handshake. A waiter counts itself in waiters before its last
+  check of the ring, and stays counted until it runs again. A waker wakes
+  one more thread only while waiters exceed wakes, the wakes that reached a
+  sleeper that has not run yet; a wake that found nobody is taken back,
+  since the waiter it was meant for has not slept and will see the new
+  index when it does. So whenever a thread sleeps, waiters > wakes and the
+  next push or pop wakes someone.
+*/
+static inline void ring_wake(int *waiters, int *wakes, int *addr) {
+  if (__atomic_load_n(waiters, __ATOMIC_RELAXED) <=
+      __atomic_load_n(wakes, __ATOMIC_RELAXED))
+    return;
+  __atomic_add_fetch(wakes, 1, __ATOMIC_RELAXED);
+  if (futex_wake(addr, 1) == 0)
+    __atomic_sub_fetch(wakes, 1, __ATOMIC_RELAXED);
+}
+
+// A waiter running again: woken says a wake reached it
+static inline void ring_woke(int *waiters, int *wakes, int woken) {
+  if (woken)
+    __atomic_sub_fetch(wakes, 1, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(waiters, 1, __ATOMIC_RELAXED);
+}
+
+template <typename T> struct MpmcRing {
+  alignas(64) unsigned head; // next position to claim for a pop
+  alignas(64) unsigned tail; // next position to claim for a push
+
+  alignas(64) int pop_waiters; // consumers between announcing and waking
+  int pop_wakes;   // wakes that found a consumer, not yet taken by it
+  int push_waiters; // and the same for producers
+  int push_wakes;
+  unsigned long long pop_waits;
+  unsigned long long push_waits;
+
+  alignas(64) unsigned mask;
+  MpmcCell<T> *cells;
+};
+
+template <typename T>
+static inline void mpmc_init(MpmcRing<T> *q, unsigned capacity) {
+  q->head = q->tail = 0;
+  q->pop_waiters = q->pop_wakes = q->push_waiters = q->push_wakes = 0;
+  q->pop_waits = q->push_waits = 0;
+  q->mask = ring_round_up(capacity) - 1;
+  q->cells = new MpmcCell<T>[q->mask + 1];
+  for (unsigned i = 0; i <= q->mask; i++)
+    q->cells[i].seq = i;
+}
+
+template <typename T> static inline void mpmc_destroy(MpmcRing<T> *q) {
+  delete[] q->cells;
+}
+
+/**
+ * Push without blocking.
+ * @return 1 if the item went in, 0 if the ring is full.
+ */
+template <typename T>
+static inline int mpmc_try_push(MpmcRing<T> *q, const T &item) {
+  unsigned pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+  MpmcCell<T> *cell;
+  for (;;) {
+    cell = &q->cells[pos & q->mask];
+    int diff = (int)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      return 0; // the cell still holds the item from one lap ago
+    } else {
+      pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    }
+  }
+  cell->value = item;
+  __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+  // Either a consumer about to sleep sees the new tail, or its count is
+  // visible here
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  ring_wake(&q->pop_waiters, &q->pop_wakes, (int *)&q->tail);
+  return 1;
+}
+
+/**
+ * Pop without blocking.
+ * @return 1 with *item set, 0 if the ring is empty.
+ */
+template <typename T> static inline int mpmc_try_pop(MpmcRing<T> *q, T *item) {
+  unsigned pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+  MpmcCell<T> *cell;
+  for (;;) {
+    cell = &q->cells[pos & q->mask];
+    int diff = (int)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      return 0; // not filled yet
+    } else {
+      pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    }
+  }
+  *item = cell->value;
+  __atomic_store_n(&cell->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  ring_wake(&q->push_waiters, &q->push_wakes, (int *)&q->head);
+  return 1;
+}
+
+template <typename T>
+static inline void mpmc_push(MpmcRing<T> *q, const T &item) {
+  for (int i = 0; i < RING_SPINS; i++) {
+    if (mpmc_try_push(q, item))
+      return;
+    ring_relax();
+  }
+  while (!mpmc_try_push(q, item)) {
+    // Count this producer before re-reading head, and keep it counted until
+    // it is awake again, so every pop in between wakes someone
+    __atomic_add_fetch(&q->push_waiters, 1, __ATOMIC_SEQ_CST);
+    unsigned head = __atomic_load_n(&q->head, __ATOMIC_SEQ_CST);
+    unsigned tail = __atomic_load_n(&q->tail, __ATOMIC_SEQ_CST);
+    int woken = 0;
+    if (tail - head > q->mask) {
+      __atomic_add_fetch(&q->push_waits, 1, __ATOMIC_RELAXED);
+      woken = futex_wait((int *)&q->head, (int)head) == 0;
+    } else {
+      // A consumer has claimed a cell but not released it yet
+      sched_yield();
+    }
+    ring_woke(&q->push_waiters, &q->push_wakes, woken);
+  }
+}
+
+template <typename T> static inline void mpmc_pop(MpmcRing<T> *q, T *item) {
+  for (int i = 0; i < RING_SPINS; i++) {
+    if (mpmc_try_pop(q, item))
+      return;
+    ring_relax();
+  }
+  while (!mpmc_try_pop(q, item)) {
+    __atomic_add_fetch(&q->pop_waiters, 1, __ATOMIC_SEQ_CST);
+    unsigned head = __atomic_load_n(&q->head, __ATOMIC_SEQ_CST);
+    unsigned tail = __atomic_load_n(&q->tail, __ATOMIC_SEQ_CST);
+    int woken = 0;
+    if (tail == head) {
+      __atomic_add_fetch(&q->pop_waits, 1, __ATOMIC_RELAXED);
+      woken = futex_wait((int *)&q->tail, (int)tail) == 0;
+    } else {
+      // A producer has claimed a cell but not filled it yet
+      sched_yield();
+    }
+    ring_woke(&q->pop_waiters, &q->pop_wakes, woken);
+  }
+}
+
+#endif
@@ -0,0 +1,265 @@
+/*
+  Benchmark driver for the operative simulation (2105110/2105110.cpp).
+
+  Runs the simulation binary once per point of a grid over the input
+  parameters (N, M, x, y), the execution mode (threads, pool, virtual) and,
+  in pool mode, the worker count, and writes one CSV row per run:
+
+    mode,N,M,x,y,workers,rep,wall_s,units,makespan_s,units_per_s,
+    unit_mean_s,unit_p50_s,unit_p95_s,unit_p99_s,unit_max_s,user_s,sys_s,
+    vol_ctx_switches,invol_ctx_switches,max_rss_kb
+
+  units_per_s is units logged over the simulation's makespan (first arrival
+  to last unit logged, on the simulation's own clock), the unit latencies are
+  from a unit's first member arriving to the unit being logged. CPU time,
+  context switches and peak RSS come from getrusage via wait4 on the child.
+
+  Every repetition r runs with --seed <seed + r>, so the same grid replays
+  the same workload and two CSVs from different commits can be diffed or
+  joined row by row.
+
+  Compilation:
+    g++ -O2 sim_bench.cpp -o sim_bench
+
+  Usage:
+    ./sim_bench [--sim PATH] [--n LIST] [--m LIST] [--x LIST] [--y LIST]
+                [--mode LIST] [--workers LIST] [--reps R] [--seed S]
+                [--out FILE] [-- extra simulation options]
+
+    LIST is comma separated, e.g. --n 16,64,256 --mode pool,virtual.
+    Defaults: --sim ./a.out --n 16,64 --m 4 --x 1 --y 0,1
+              --mode virtual,pool,threads --workers 1,4 --reps 1 --seed 1,
+              CSV on stdout. Points where M does not divide N are skipped.
+
+    Anything after -- is passed to every run, e.g. -- --logbook writer.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "bench_util.h"
+
+typedef struct {
+  long long units;
+  long long makespan_us;
+  long long p50_us, p95_us, p99_us, max_us, mean_us;
+} SimResult;
+
+static std::vector<std::string> parse_words(const char *text) {
+  std::vector<std::string> words;
+  std::string current;
+  for (const char *p = text;; p++) {
+    if (*p == ',' || *p == '\0') {
+      if (!current.empty())
+        words.push_back(current);
+      current.clear();
+      if (*p == '\0')
+        break;
+    } else {
+      current += *p;
+    }
+  }
+  return words;
+}
+
+/**
+ * Run the simulation once with the given arguments, collecting the csv
+ * summary it prints last on stderr and the child's resource usage.
+ * @return 0 on success, -1 if the run failed or printed no summary.
+ */
+static int run_sim(std::vector<std::string> &args, SimResult *result,
+                   struct rusage *usage, double *wall_s) {
+  int pipefd[2];
+  if (pipe(pipefd) != 0)
+    return -1;
+
+  double start = now_s();
+  pid_t pid = fork();
+  if (pid < 0)
+    return -1;
+  if (pid == 0) {
+    std::vector<char *> argv;
+    for (std::string &a : args)
+      argv.push_back((char *)a.c_str());
+    argv.push_back(NULL);
+
+    dup2(pipefd[1], STDERR_FILENO);
+    close(pipefd[0]);
+    close(pipefd[1]);
+    execv(argv[0], argv.data());
+    perror("execv");
+    _exit(127);
+  }
+
+  close(pipefd[1]);
+  std::string output;
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(pipefd[0], buf, sizeof(buf))) > 0 ||
+         (n < 0 && errno == EINTR)) {
+    if (n > 0)
+      output.append(buf, n);
+  }
+  close(pipefd[0]);
+
+  int status;
+  while (wait4(pid, &status, 0, usage) < 0 && errno == EINTR)
+    ;
+  *wall_s = now_s() - start;
+
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "sim_bench: run failed:\n%s", output.c_str());
+    return -1;
+  }
+
+  // The summary row is the last non-empty line
+  while (!output.empty() && output.back() == '\n')
+    output.pop_back();
+  size_t line = output.rfind('\n');
+  const char *row = output.c_str() + (line == std::string::npos ? 0 : line + 1);
+  if (sscanf(row, "%lld,%lld,%lld,%lld,%lld,%lld,%lld", &result->units,
+             &result->makespan_us, &result->p50_us, &result->p95_us,
+             &result->p99_us, &result->max_us, &result->mean_us) != 7) {
+    fprintf(stderr, "sim_bench: no summary in output:\n%s\n", output.c_str());
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  std::string sim = "./a.out";
+  std::vector<int> ns = {16, 64}, ms = {4}, xs = {1}, ys = {0, 1};
+  std::vector<int> workers = {1, 4};
+  std::vector<std::string> modes = {"virtual", "pool", "threads"};
+  std::vector<std::string> extra;
+  int reps = 1;
+  long long seed = 1;
+  const char *out_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--") == 0) {
+      for (i++; i < argc; i++)
+        extra.push_back(argv[i]);
+      break;
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (strcmp(arg, "--sim") == 0)
+      sim = value;
+    else if (strcmp(arg, "--n") == 0)
+      ns = parse_list(value);
+    else if (strcmp(arg, "--m") == 0)
+      ms = parse_list(value);
+    else if (strcmp(arg, "--x") == 0)
+      xs = parse_list(value);
+    else if (strcmp(arg, "--y") == 0)
+      ys = parse_list(value);
+    else if (strcmp(arg, "--mode") == 0)
+      modes = parse_words(value);
+    else if (strcmp(arg, "--workers") == 0)
+      workers = parse_list(value);
+    else if (strcmp(arg, "--reps") == 0)
+      reps = atoi(value);
+    else if (strcmp(arg, "--seed") == 0)
+      seed = atoll(value);
+    else if (strcmp(arg, "--out") == 0)
+      out_path = value;
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Error opening %s\n", out_path);
+    return 1;
+  }
+
+  char input_path[] = "/tmp/sim_bench_XXXXXX";
+  int input_fd = mkstemp(input_path);
+  if (input_fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(input_fd);
+
+  fprintf(out, "mode,N,M,x,y,workers,rep,wall_s,units,makespan_s,units_per_s,"
+               "unit_mean_s,unit_p50_s,unit_p95_s,unit_p99_s,unit_max_s,user_s,sys_s,"
+               "vol_ctx_switches,invol_ctx_switches,max_rss_kb\n");
+
+  int failures = 0;
+  for (int n : ns)
+    for (int m : ms)
+      for (int x : xs)
+        for (int y : ys) {
+          if (n <= 0 || m <= 0 || n % m != 0)
+            continue;
+          FILE *input = fopen(input_path, "w");
+          fprintf(input, "%d %d\n%d %d\n", n, m, x, y);
+          fclose(input);
+
+          for (const std::string &mode : modes) {
+            // Worker count only varies pool mode; threads runs N + 2
+            // threads, virtual runs on the main thread
+            std::vector<int> counts = {mode == "threads" ? n + 2 : 1};
+            if (mode == "pool")
+              counts = workers;
+
+            for (int k : counts)
+              for (int rep = 0; rep < reps; rep++) {
+                std::vector<std::string> args = {sim, input_path,
+                                                 "/dev/null"};
+                if (mode == "pool") {
+                  args.push_back("--pool");
+                  args.push_back("--workers");
+                  args.push_back(std::to_string(k));
+                } else if (mode == "virtual") {
+                  args.push_back("--virtual");
+                }
+                args.push_back("--seed");
+                args.push_back(std::to_string(seed + rep));
+                args.push_back("--metrics");
+                args.push_back("csv");
+                args.insert(args.end(), extra.begin(), extra.end());
+
+                SimResult r;
+                struct rusage ru;
+                double wall;
+                if (run_sim(args, &r, &ru, &wall) != 0) {
+                  failures++;
+                  continue;
+                }
+
+                double makespan = r.makespan_us / 1e6;
+                fprintf(out,
+                        "%s,%d,%d,%d,%d,%d,%d,%.6f,%lld,%.6f,%.6f,%.6f,%.6f,"
+                        "%.6f,%.6f,%.6f,%.6f,%.6f,%ld,%ld,%ld\n",
+                        mode.c_str(), n, m, x, y, k, rep, wall, r.units,
+                        makespan, makespan > 0 ? r.units / makespan : 0.0,
+                        r.mean_us / 1e6, r.p50_us / 1e6, r.p95_us / 1e6, r.p99_us / 1e6,
+                        r.max_us / 1e6, tv_s(ru.ru_utime), tv_s(ru.ru_stime),
+                        ru.ru_nvcsw, ru.ru_nivcsw, ru.ru_maxrss);
+                fflush(out);
+              }
+          }
+        }
+
+  unlink(input_path);
+  if (out != stdout)
+    fclose(out);
+  return failures ? 1 : 0;
+}
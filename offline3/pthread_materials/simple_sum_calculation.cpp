@@ -37,7 +37,7 @@ public:
 void *computeSum(void *arg) {
   ThreadData *data = (ThreadData *)arg;
   data->sum = 0; // Initialize the thread's sum to zero
-  for (int i = data->start; i <= data->end; i++) {
+  for (long i = data->start; i <= data->end; i++) {
     data->sum += i; // Add each number in the range to the thread's sum
   }
   return NULL;
@@ -0,0 +1,169 @@
+/*
+  Live view of a running simulation's counters.
+
+  2105110.cpp --live NAME publishes its counters in /dev/shm/NAME
+  (live_metrics.h). simtop maps that segment read-only and every interval
+  prints the counters and their rates over the last interval:
+
+    arrived, typed, units completed, completed operations   totals and /s
+    stations busy, readers, writers waiting                 current values
+    writer wait                                             queued time per
+                                                            logbook write
+
+  Reading the segment takes no syscall and no lock on either side. simtop
+  waits for the segment to appear and exits once the simulation marks it
+  finished. On a terminal the view is redrawn in place; otherwise one line
+  per interval is printed, for logging a sweep.
+
+  Compilation:
+    g++ -O2 simtop.cpp -o simtop
+
+  Usage:
+    ./simtop NAME [--interval MS] [--once]
+
+    --interval  refresh period in milliseconds (default 1000)
+    --once      print one sample and exit
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "live_metrics.h"
+
+typedef struct {
+  long long arrived, typed, units_completed, completed_operations;
+  long long stations_busy, readers, writers_waiting, writer_wait_us;
+  long long runs_started, runs_finished, operatives_total, units_total;
+  double at_s;
+} LiveSample;
+
+static double now_s() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void take_sample(const LiveMetrics *live, LiveSample *s) {
+  s->arrived = live_read(&live->arrived);
+  s->typed = live_read(&live->typed);
+  s->units_completed = live_read(&live->units_completed);
+  s->completed_operations = live_read(&live->completed_operations);
+  s->stations_busy = live_read(&live->stations_busy);
+  s->readers = live_read(&live->readers);
+  s->writers_waiting = live_read(&live->writers_waiting);
+  s->writer_wait_us = live_read(&live->writer_wait_us);
+  s->runs_started = live_read(&live->runs_started);
+  s->runs_finished = live_read(&live->runs_finished);
+  s->operatives_total = live_read(&live->operatives_total);
+  s->units_total = live_read(&live->units_total);
+  s->at_s = now_s();
+}
+
+static double rate(long long now, long long before, double dt) {
+  return dt > 0 ? (now - before) / dt : 0.0;
+}
+
+static void print_screen(const char *name, int pid, const LiveSample *s,
+                         const LiveSample *prev, double started_s) {
+  double dt = s->at_s - prev->at_s;
+  long long writes = s->completed_operations - prev->completed_operations;
+  double wait_ms =
+      writes > 0 ? (s->writer_wait_us - prev->writer_wait_us) / 1e3 / writes
+                 : 0.0;
+
+  printf("\033[H\033[2J");
+  printf("simtop  /dev/shm/%s  pid %d  runs %lld/%lld  watching %.1f s\n\n",
+         name, pid, s->runs_finished, s->runs_started, s->at_s - started_s);
+  printf("%-22s %12s %12s %12s\n", "", "total", "of", "per s");
+  printf("%-22s %12lld %12lld %12.1f\n", "arrived", s->arrived,
+         s->operatives_total, rate(s->arrived, prev->arrived, dt));
+  printf("%-22s %12lld %12lld %12.1f\n", "typed", s->typed,
+         s->operatives_total, rate(s->typed, prev->typed, dt));
+  printf("%-22s %12lld %12lld %12.1f\n", "units completed",
+         s->units_completed, s->units_total,
+         rate(s->units_completed, prev->units_completed, dt));
+  printf("%-22s %12lld %12lld %12.1f\n", "completed operations",
+         s->completed_operations, s->units_total,
+         rate(s->completed_operations, prev->completed_operations, dt));
+  printf("\n%-22s %12s\n", "", "now");
+  printf("%-22s %12lld\n", "stations busy", s->stations_busy);
+  printf("%-22s %12lld\n", "readers", s->readers);
+  printf("%-22s %12lld %12.3f ms queued per write\n", "writers waiting",
+         s->writers_waiting, wait_ms);
+  fflush(stdout);
+}
+
+static void print_line(const LiveSample *s, const LiveSample *prev,
+                       double started_s) {
+  double dt = s->at_s - prev->at_s;
+  printf("%.1f s  arrived %lld (%.1f/s)  units %lld (%.1f/s)  ops %lld "
+         "(%.1f/s)  busy %lld  readers %lld  writers waiting %lld\n",
+         s->at_s - started_s, s->arrived, rate(s->arrived, prev->arrived, dt),
+         s->units_completed,
+         rate(s->units_completed, prev->units_completed, dt),
+         s->completed_operations,
+         rate(s->completed_operations, prev->completed_operations, dt),
+         s->stations_busy, s->readers, s->writers_waiting);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+  const char *name = NULL;
+  int interval_ms = 1000, once = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+      interval_ms = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--once") == 0)
+      once = 1;
+    else if (argv[i][0] != '-' && !name)
+      name = argv[i];
+    else {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (!name || interval_ms <= 0) {
+    fprintf(stderr, "Usage: %s NAME [--interval MS] [--once]\n", argv[0]);
+    return 1;
+  }
+
+  const LiveMetrics *live;
+  int waited = 0;
+  while (!(live = live_attach(name))) {
+    if (once) {
+      fprintf(stderr, "No live metrics segment /dev/shm/%s\n", name);
+      return 1;
+    }
+    if (!waited++)
+      fprintf(stderr, "Waiting for /dev/shm/%s\n", name);
+    usleep(100000);
+  }
+
+  int tty = isatty(STDOUT_FILENO);
+  double started_s = now_s();
+  LiveSample prev, cur;
+  take_sample(live, &prev);
+
+  for (;;) {
+    if (!once)
+      usleep(interval_ms * 1000);
+    int finished = __atomic_load_n(&live->finished, __ATOMIC_ACQUIRE);
+    take_sample(live, &cur);
+    if (tty)
+      print_screen(name, live->pid, &cur, &prev, started_s);
+    else
+      print_line(&cur, &prev, started_s);
+    if (finished || once)
+      break;
+    prev = cur;
+  }
+  if (tty && !once)
+    printf("\nfinished\n");
+
+  live_detach(live);
+  return 0;
+}
@@ -0,0 +1,461 @@
+/*
+  Typewriting stations shared by the operative simulations.
+
+  The number of stations and how many operatives each one seats at a time
+  are set at runtime, and so is the dispatch policy that decides where an
+  arriving operative types:
+
+    modulo - the operative's fixed home station (ID mod station count); it
+             waits there even if another station is idle.
+    jsq    - join the shortest queue: on arrival pick the station with the
+             fewest operatives at it or waiting for it, home station first
+             on ties.
+    shared - one queue in front of all stations; whichever station frees up
+             first takes the next operative.
+
+  station_acquire() and station_release() are the blocking (one thread per
+  operative) implementation and keep the metrics.h statistics for every
+  station.
+
+  Admission order among operatives queued for the same seat is whatever
+  order the semaphore wakes them in (STATION_ADMIT_FIFO), or with
+  STATION_ADMIT_PRIORITY the waiter with the smallest priority (ties go to
+  the earliest arrival). Waiters come in groups that share a priority (the
+  simulations group by unit), kept in an AdmitQueue: one FIFO bucket per
+  group, buckets ranked by priority. Handing over a seat is O(log groups);
+  when a group's priority changes the caller re-ranks its bucket with
+  station_rekey() instead of every waiter being re-evaluated per release.
+
+  Seat semaphores come from the sync_backend.h backend passed to
+  stations_init(). Priority admission uses the same seat semaphores, taken
+  and given back under a per-queue lock so the waiters and the free seats
+  change together, and parks each waiter on a semaphore of its own from
+  that backend until a seat is handed to it. Schedulers that park tasks
+  instead of threads (pool mode in 2105110.cpp) use the same StationSet for
+  its configuration, locks, admission queues, load counts and statistics.
+*/
+
+#ifndef STATIONS_H
+#define STATIONS_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <deque>
+#include <set>
+#include <unordered_map>
+
+#include "metrics.h"
+#include "sync_backend.h"
+
+enum StationDispatch { DISPATCH_MODULO, DISPATCH_JSQ, DISPATCH_SHARED };
+
+static const char *station_dispatch_names[] = {"modulo", "jsq", "shared"};
+
+enum StationAdmission { STATION_ADMIT_FIFO, STATION_ADMIT_PRIORITY };
+
+// An operative parked for a seat under priority admission
+typedef struct {
+  int station;           // seat handed over, set before granted is posted
+  SyncSemaphore granted; // posted once by the releasing operative
+} StationWaiter;
+
+typedef struct {
+  unsigned long long seq;
+  void *item;
+} AdmitEntry;
+
+typedef struct {
+  long long key;                 // shared by the group, smaller goes first
+  std::deque<AdmitEntry> queued; // arrival order, never empty
+} AdmitGroup;
+
+// A group's place in line: its key, then its oldest waiter's arrival
+typedef struct AdmitRank {
+  long long key;
+  unsigned long long seq;
+  int group;
+  bool operator<(const AdmitRank &o) const {
+    if (key != o.key)
+      return key < o.key;
+    return seq < o.seq;
+  }
+} AdmitRank;
+
+// Priority wait queue for one seat queue; guarded by the queue's lock
+typedef struct AdmitQueue {
+  std::unordered_map<int, AdmitGroup> groups;
+  std::set<AdmitRank> order; // one rank per group in groups
+  unsigned long long next_seq = 0;
+} AdmitQueue;
+
+static inline int admit_queue_empty(const AdmitQueue *q) {
+  return q->order.empty();
+}
+
+// Move a queued group to its new key; a no-op if it has no waiters
+static inline void admit_queue_rekey(AdmitQueue *q, int group,
+                                     long long key) {
+  std::unordered_map<int, AdmitGroup>::iterator it = q->groups.find(group);
+  if (it == q->groups.end() || it->second.key == key)
+    return;
+  AdmitGroup *g = &it->second;
+  unsigned long long seq = g->queued.front().seq;
+  q->order.erase(AdmitRank{g->key, seq, group});
+  g->key = key;
+  q->order.insert(AdmitRank{key, seq, group});
+}
+
+// Queue item behind its group; key is the group's current priority
+static inline void admit_queue_push(AdmitQueue *q, int group, long long key,
+                                    void *item) {
+  AdmitEntry e = {q->next_seq++, item};
+  std::unordered_map<int, AdmitGroup>::iterator it = q->groups.find(group);
+  if (it == q->groups.end()) {
+    AdmitGroup *g = &q->groups[group];
+    g->key = key;
+    g->queued.push_back(e);
+    q->order.insert(AdmitRank{key, e.seq, group});
+    return;
+  }
+  it->second.queued.push_back(e);
+  admit_queue_rekey(q, group, key);
+}
+
+/**
+ * Remove the oldest waiter of the best ranked group.
+ * @return Its item; the queue must not be empty.
+ */
+static inline void *admit_queue_pop(AdmitQueue *q) {
+  AdmitRank top = *q->order.begin();
+  q->order.erase(q->order.begin());
+  std::unordered_map<int, AdmitGroup>::iterator it = q->groups.find(top.group);
+  AdmitGroup *g = &it->second;
+  void *item = g->queued.front().item;
+  g->queued.pop_front();
+  if (g->queued.empty())
+    q->groups.erase(it);
+  else
+    q->order.insert(AdmitRank{g->key, g->queued.front().seq, top.group});
+  return item;
+}
+
+typedef struct {
+  int count;
+  int capacity;
+  int dispatch;
+  int admission;
+  int backend; // sync_backend.h backend of every semaphore below
+
+  SyncSemaphore *sems;        // modulo, jsq: one per station, capacity seats
+  SyncSemaphore shared_slots; // shared: free seats over all stations
+  pthread_mutex_t pick_lock;  // shared: finds a station with a free seat
+
+  int *load; // jsq: operatives at or queued for; shared: operatives at
+
+  // Priority admission: per-station locks and waiters, the shared queue is
+  // waiters[count] under pick_lock
+  pthread_mutex_t *locks;
+  AdmitQueue *waiters;
+
+  ResourceStats *stats;       // per station
+  ResourceStats shared_stats; // shared: the common queue in front
+} StationSet;
+
+/**
+ * Parse a dispatch policy name as accepted on the command line.
+ * @return The policy, or -1 if the name is unknown.
+ */
+static inline int station_parse_dispatch(const char *name) {
+  for (int i = 0; i < 3; i++) {
+    if (strcmp(name, station_dispatch_names[i]) == 0)
+      return i;
+  }
+  return -1;
+}
+
+static inline long long station_clock_us() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+static inline void stations_init(StationSet *set, int count, int capacity,
+                                 int dispatch, int backend = SYNC_POSIX) {
+  set->count = count;
+  set->capacity = capacity;
+  set->dispatch = dispatch;
+  set->admission = STATION_ADMIT_FIFO;
+  set->backend = backend;
+  set->sems = (SyncSemaphore *)malloc(count * sizeof(SyncSemaphore));
+  set->load = (int *)calloc(count, sizeof(int));
+  set->stats = (ResourceStats *)malloc(count * sizeof(ResourceStats));
+  set->locks = (pthread_mutex_t *)malloc(count * sizeof(pthread_mutex_t));
+  set->waiters = new AdmitQueue[count + 1];
+
+  for (int i = 0; i < count; i++) {
+    sync_sem_init(&set->sems[i], backend, capacity);
+    resource_init(&set->stats[i], capacity);
+    pthread_mutex_init(&set->locks[i], NULL);
+  }
+  sync_sem_init(&set->shared_slots, backend, count * capacity);
+  pthread_mutex_init(&set->pick_lock, NULL);
+  resource_init(&set->shared_stats, count * capacity);
+}
+
+static inline void stations_destroy(StationSet *set) {
+  for (int i = 0; i < set->count; i++) {
+    sync_sem_destroy(&set->sems[i]);
+    pthread_mutex_destroy(&set->locks[i]);
+  }
+  sync_sem_destroy(&set->shared_slots);
+  pthread_mutex_destroy(&set->pick_lock);
+  free(set->sems);
+  free(set->load);
+  free(set->stats);
+  free(set->locks);
+  delete[] set->waiters;
+}
+
+/**
+ * Join-shortest-queue choice. Loads are read without a lock: two operatives
+ * arriving together may pick the same station, which only costs balance.
+ */
+static inline int station_pick_jsq(StationSet *set, int home) {
+  int best = home;
+  int best_load = __atomic_load_n(&set->load[home], __ATOMIC_RELAXED);
+  for (int i = 0; i < set->count && best_load > 0; i++) {
+    int load = __atomic_load_n(&set->load[i], __ATOMIC_RELAXED);
+    if (load < best_load) {
+      best = i;
+      best_load = load;
+    }
+  }
+  __atomic_add_fetch(&set->load[best], 1, __ATOMIC_RELAXED);
+  return best;
+}
+
+/**
+ * Shared dispatch: claim a seat at a station with room, home station first.
+ * Call with pick_lock held.
+ * @return The station, or -1 if every seat is taken.
+ */
+static inline int station_pick_free(StationSet *set, int home) {
+  for (int i = 0; i < set->count; i++) {
+    int s = (home + i) % set->count;
+    if (set->load[s] < set->capacity) {
+      set->load[s]++;
+      return s;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Re-rank a group's queued waiters after its priority changed. priority and
+ * ctx are those of any member; the key is read under each queue's lock, so
+ * the last call after a change always leaves the current value. A no-op
+ * under FIFO admission.
+ */
+static inline void station_rekey(StationSet *set, int group,
+                                  long long (*priority)(void *), void *ctx) {
+  if (set->admission != STATION_ADMIT_PRIORITY)
+    return;
+  if (set->dispatch == DISPATCH_SHARED) {
+    pthread_mutex_lock(&set->pick_lock);
+    admit_queue_rekey(&set->waiters[set->count], group, priority(ctx));
+    pthread_mutex_unlock(&set->pick_lock);
+    return;
+  }
+  for (int i = 0; i < set->count; i++) {
+    pthread_mutex_lock(&set->locks[i]);
+    if (!admit_queue_empty(&set->waiters[i]))
+      admit_queue_rekey(&set->waiters[i], group, priority(ctx));
+    pthread_mutex_unlock(&set->locks[i]);
+  }
+}
+
+static inline int station_acquire_priority(StationSet *set, int home,
+                                           long long (*priority)(void *),
+                                           void *ctx, int group,
+                                           long long *start_us) {
+  long long asked = station_clock_us();
+  int shared = set->dispatch == DISPATCH_SHARED;
+  int q = shared ? set->count
+                 : (set->dispatch == DISPATCH_JSQ ? station_pick_jsq(set, home)
+                                                  : home);
+  pthread_mutex_t *lock = shared ? &set->pick_lock : &set->locks[q];
+  ResourceStats *queue_stats = shared ? &set->shared_stats : &set->stats[q];
+  int station = -1;
+  int queued = 0;
+
+  pthread_mutex_lock(lock);
+  if (admit_queue_empty(&set->waiters[q])) {
+    if (shared) {
+      if (sync_sem_trywait(&set->shared_slots) == 0)
+        station = station_pick_free(set, home);
+    } else if (sync_sem_trywait(&set->sems[q]) == 0) {
+      station = q;
+    }
+  }
+  if (station >= 0) {
+    pthread_mutex_unlock(lock);
+  } else {
+    StationWaiter w;
+    sync_sem_init(&w.granted, set->backend, 0);
+
+    queued = 1;
+    resource_enqueue(queue_stats);
+    admit_queue_push(&set->waiters[q], group, priority ? priority(ctx) : 0,
+                     &w);
+    pthread_mutex_unlock(lock);
+    sync_sem_wait(&w.granted);
+    station = w.station;
+
+    // The releaser posts under lock: once it is free again, the post has
+    // returned and the semaphore can go
+    pthread_mutex_lock(lock);
+    pthread_mutex_unlock(lock);
+    sync_sem_destroy(&w.granted);
+  }
+
+  *start_us = station_clock_us();
+  resource_acquired(queue_stats, *start_us - asked, queued);
+  if (shared)
+    resource_acquired(&set->stats[station], *start_us - asked, 0);
+  return station;
+}
+
+// Hand the seat to the best waiter, or free it
+static inline void station_release_priority(StationSet *set, int station) {
+  int shared = set->dispatch == DISPATCH_SHARED;
+  int q = shared ? set->count : station;
+  pthread_mutex_t *lock = shared ? &set->pick_lock : &set->locks[q];
+
+  pthread_mutex_lock(lock);
+  if (!admit_queue_empty(&set->waiters[q])) {
+    StationWaiter *w = (StationWaiter *)admit_queue_pop(&set->waiters[q]);
+    w->station = station;
+    sync_sem_post(&w->granted);
+  } else if (shared) {
+    set->load[station]--;
+    sync_sem_post(&set->shared_slots);
+  } else {
+    sync_sem_post(&set->sems[station]);
+  }
+  pthread_mutex_unlock(lock);
+
+  if (set->dispatch == DISPATCH_JSQ)
+    __atomic_sub_fetch(&set->load[station], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Block until the dispatch policy seats the operative at a station.
+ * @param home The operative's static station (ID mod station count).
+ * @param start_us Set to when the operative got the seat.
+ * @param priority,ctx Under priority admission, ranks this operative
+ *        against the others waiting for the same seat.
+ * @param group Under priority admission, the operative's group: members
+ *        share one priority and go in arrival order among themselves.
+ * @return The station the operative got.
+ */
+static inline int station_acquire(StationSet *set, int home,
+                                  long long *start_us,
+                                  long long (*priority)(void *) = NULL,
+                                  void *ctx = NULL, int group = 0) {
+  if (set->admission == STATION_ADMIT_PRIORITY)
+    return station_acquire_priority(set, home, priority, ctx, group,
+                                    start_us);
+
+  long long asked = station_clock_us();
+  int queued = 0;
+  int station;
+
+  if (set->dispatch == DISPATCH_SHARED) {
+    if (sync_sem_trywait(&set->shared_slots) != 0) {
+      queued = 1;
+      resource_enqueue(&set->shared_stats);
+      sync_sem_wait(&set->shared_slots);
+    }
+    pthread_mutex_lock(&set->pick_lock);
+    station = station_pick_free(set, home);
+    pthread_mutex_unlock(&set->pick_lock);
+
+    *start_us = station_clock_us();
+    resource_acquired(&set->shared_stats, *start_us - asked, queued);
+    resource_acquired(&set->stats[station], *start_us - asked, 0);
+    return station;
+  }
+
+  station = set->dispatch == DISPATCH_JSQ ? station_pick_jsq(set, home) : home;
+  if (sync_sem_trywait(&set->sems[station]) != 0) {
+    queued = 1;
+    resource_enqueue(&set->stats[station]);
+    sync_sem_wait(&set->sems[station]);
+  }
+  *start_us = station_clock_us();
+  resource_acquired(&set->stats[station], *start_us - asked, queued);
+  return station;
+}
+
+static inline void station_release(StationSet *set, int station,
+                                   long long start_us) {
+  long long held = station_clock_us() - start_us;
+  resource_released(&set->stats[station], held);
+
+  if (set->admission == STATION_ADMIT_PRIORITY) {
+    if (set->dispatch == DISPATCH_SHARED)
+      resource_released(&set->shared_stats, held);
+    station_release_priority(set, station);
+    return;
+  }
+
+  if (set->dispatch == DISPATCH_SHARED) {
+    resource_released(&set->shared_stats, held);
+    pthread_mutex_lock(&set->pick_lock);
+    set->load[station]--;
+    pthread_mutex_unlock(&set->pick_lock);
+    sync_sem_post(&set->shared_slots);
+    return;
+  }
+
+  sync_sem_post(&set->sems[station]);
+  if (set->dispatch == DISPATCH_JSQ)
+    __atomic_sub_fetch(&set->load[station], 1, __ATOMIC_RELAXED);
+}
+
+// metrics.h table rows for every station, plus the shared queue if used
+static inline void stations_report(StationSet *set, long long elapsed_us,
+                                   FILE *out) {
+  char name[16];
+  for (int i = 0; i < set->count; i++) {
+    snprintf(name, sizeof(name), "TS%d", i + 1);
+    resource_report_row(out, name, &set->stats[i], elapsed_us);
+  }
+  if (set->dispatch == DISPATCH_SHARED)
+    resource_report_row(out, "shared", &set->shared_stats, elapsed_us);
+}
+
+// JSON members "dispatch", "stations" and (shared dispatch) "shared", for
+// the caller to place inside its own object
+static inline void stations_report_json(StationSet *set, long long elapsed_us,
+                                        FILE *out) {
+  char name[16];
+  fprintf(out, "\"dispatch\": \"%s\", \"stations\": [",
+          station_dispatch_names[set->dispatch]);
+  for (int i = 0; i < set->count; i++) {
+    snprintf(name, sizeof(name), "TS%d", i + 1);
+    fprintf(out, i ? ", " : "");
+    resource_report_json(out, name, &set->stats[i], elapsed_us);
+  }
+  fprintf(out, "]");
+  if (set->dispatch == DISPATCH_SHARED) {
+    fprintf(out, ", \"shared\": ");
+    resource_report_json(out, "shared", &set->shared_stats, elapsed_us);
+  }
+}
+
+#endif
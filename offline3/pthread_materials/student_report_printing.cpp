@@ -10,14 +10,27 @@
   MAX_WRITING_TIME seconds.
     - Students "write" their reports, then arrive at the print station and log
   their arrival time.
-    - Student actions are handled using threads, and each student's arrival is
-  recorded in a thread-safe manner to prevent log mixing.
+    - Students start in a random order (a shuffle of all IDs), one every
+  LAUNCH_INTERVAL_US; whoever has not started by LAUNCH_WINDOW_US starts then.
+    - Student actions are handled by a fixed pool of worker threads: each
+  student is a small state machine whose next step (finish writing, arrive
+  at the printer) waits in a timer heap until it is due, so no thread
+  sleeps per student and a million students need no million threads.
+    - Each student's arrival is recorded in a thread-safe manner to prevent
+  log mixing: every line is formatted by the worker that logs it and written
+  out by a single writer thread (see async_log.h).
 
   Compilation:
-    g++ -pthread student_report_printing.cpp -o a.out
+    g++ -std=c++17 -pthread student_report_printing.cpp -o a.out
 
   Usage:
-    ./a.out <input_file> <output_file>
+    ./a.out <input_file> <output_file> [--seed S] [--draws FILE]
+            [--workers W]
+
+    --seed S fixes every random delay and the launch order, so two runs with
+    the same seed do identical work; the seed used is printed to stderr.
+    --draws FILE writes every random draw (see sim_random.h) for diffing.
+    --workers W sets the size of the worker pool (default: one per CPU).
 
   Input:
     The input file should contain the number of students (N).
@@ -32,49 +45,88 @@
 */
 
 #include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <pthread.h>
+#include <queue>
 #include <random>
+#include <time.h>
 #include <unistd.h>
 #include <vector>
 
+#include "async_log.h"
+#include "sim_random.h"
+
 // Constants
 #define MAX_WRITING_TIME 20   // Maximum time a student can spend "writing"
 #define WALKING_TO_PRINTER 10 // Maximum time taken to walk to the printer
 #define SLEEP_MULTIPLIER 1000 // Multiplier to convert seconds to milliseconds
 
+#define LAUNCH_INTERVAL_US 1000  // Time between two students starting
+#define LAUNCH_WINDOW_US 7000000 // Whoever has not started by then starts
+#define LAUNCH_BATCH 256         // Most students one launcher step starts
+
 int N; // Number of students
 
-// Mutex lock for output to file for avoiding interleaving
-pthread_mutex_t output_lock;
+// Output file, written by one writer thread so lines never interleave
+AsyncLog output_log;
 
-// Timing functions
-auto start_time = std::chrono::high_resolution_clock::now();
+// Timing functions, on the monotonic clock the pool's timed waits use
+auto start_time = std::chrono::steady_clock::now();
 
 /**
  * Get the elapsed time in milliseconds since the start of the simulation.
  * @return The elapsed time in milliseconds.
  */
 long long get_time() {
-  auto end_time = std::chrono::high_resolution_clock::now();
+  auto end_time = std::chrono::steady_clock::now();
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
       end_time - start_time);
   long long elapsed_time_ms = duration.count();
   return elapsed_time_ms;
 }
 
-// Function to generate a Poisson-distributed random number
-int get_random_number() {
-  std::random_device rd;
-  std::mt19937 generator(rd());
+// Same, in microseconds, for the timer heap
+long long get_time_us() {
+  auto end_time = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(end_time -
+                                                               start_time)
+      .count();
+}
 
+/**
+ * Generate a Poisson-distributed random number, by default from the calling
+ * thread's stream (the main thread uses stream 0); students pass their own.
+ */
+int get_random_number(SimRng *rng = sim_thread_rng()) {
   // Lambda value for the Poisson distribution
   double lambda = 10000.234;
-  std::poisson_distribution<int> poissonDist(lambda);
-  return poissonDist(generator);
+  return sim_poisson(rng, lambda);
 }
 
+/**
+ * A student's (or the launcher's) next step: run(task) is called by a pool
+ * worker once the step is due.
+ */
+struct Task {
+  void (*run)(Task *task);
+};
+
+// Timer heap entry; the keys are kept inline so sifting through a million
+// entries never dereferences a Task. Ties run in scheduling order (seq).
+struct Timer {
+  long long due_us;
+  unsigned long long seq;
+  Task *task;
+};
+
+struct TimerLater {
+  bool operator()(const Timer &a, const Timer &b) const {
+    return a.due_us != b.due_us ? a.due_us > b.due_us : a.seq > b.seq;
+  }
+};
+
 enum student_state { WRITING_REPORT, WAITING_FOR_PRINTING };
 
 /**
@@ -82,9 +134,11 @@ enum student_state { WRITING_REPORT, WAITING_FOR_PRINTING };
  */
 class Student {
 public:
+  Task task;           // Next step; first member, so a Task * is a Student *
   int id;              // Unique ID for each student
   int writing_time;    // Time student spends "writing"
   student_state state; // Current state of the student (writing or waiting)
+  SimRng rng;          // The student's own random stream (stream = ID)
 
   /**
    * Constructor to initialize a student with a unique ID and random writing
@@ -93,122 +147,258 @@ public:
    */
   Student(int id) : id(id), state(WRITING_REPORT) {
     writing_time = get_random_number() % MAX_WRITING_TIME + 1;
+    sim_rng_init(&rng, id);
   }
 };
 
 std::vector<Student> students; // Vector to store all students
 
-// uses mutex lock to write output to avoid interleaving
-void write_output(std::string output) {
-  pthread_mutex_lock(&output_lock);
-  std::cout << output;
-  pthread_mutex_unlock(&output_lock);
+// Worker pool: timer heap of pending steps, guarded by pool_mutex
+std::priority_queue<Timer, std::vector<Timer>, TimerLater> pool_timers;
+pthread_mutex_t pool_mutex;
+pthread_cond_t pool_cond; // a step was scheduled or everyone has arrived
+unsigned long long pool_seq;
+int students_left; // students that have not arrived at the printer yet
+
+// Launch order: a random permutation of student indices, started in turn
+std::vector<int> launch_order;
+size_t next_launch;
+Task launcher;
+
+// formats one line (strings and integers) and queues it for the writer thread
+template <typename... Parts> void write_output(const Parts &...parts) {
+  async_log_line(&output_log, parts...);
+}
+
+/**
+ * Queue a step to run at due_us (microseconds since the start).
+ */
+void pool_schedule_at(Task *task, long long due_us) {
+  pthread_mutex_lock(&pool_mutex);
+  pool_timers.push(Timer{due_us, pool_seq++, task});
+  pthread_cond_signal(&pool_cond);
+  pthread_mutex_unlock(&pool_mutex);
 }
 
 /**
  * Simulate arriving at the printing station and log the time.
  */
-void start_printing(Student *student) {
+void start_printing(Task *task) {
+  Student *student = (Student *)task;
   student->state = WAITING_FOR_PRINTING;
 
-  write_output("Student " + std::to_string(student->id) +
-               " has arrived at the print station at " +
-               std::to_string(get_time()) + " ms\n");
+  write_output("Student ", student->id,
+               " has arrived at the print station at ", get_time(), " ms\n");
+
+  pthread_mutex_lock(&pool_mutex);
+  if (--students_left == 0)
+    pthread_cond_broadcast(&pool_cond); // let the workers exit
+  pthread_mutex_unlock(&pool_mutex);
+}
+
+/**
+ * The student puts down the report and walks to the printer.
+ */
+void finish_writing(Task *task) {
+  Student *student = (Student *)task;
+  write_output("Student ", student->id, " finished writing at ", get_time(),
+               " ms\n");
+
+  // Simulate walking to printer
+  student->task.run = start_printing;
+  pool_schedule_at(&student->task,
+                   get_time_us() +
+                       (get_random_number(&student->rng) % WALKING_TO_PRINTER +
+                        1) * SLEEP_MULTIPLIER);
 }
 
 /**
- * Initialize students and set the start time for the simulation.
+ * The student starts writing the report.
+ */
+void start_writing(Student *student) {
+  write_output("Student ", student->id, " started writing for ",
+               student->writing_time, " ms at ", get_time(), " ms\n");
+
+  // Simulate writing time
+  student->task.run = finish_writing;
+  pool_schedule_at(&student->task,
+                   get_time_us() + student->writing_time * SLEEP_MULTIPLIER);
+}
+
+// When the k-th student in launch order is due to start
+long long launch_due_us(size_t k) {
+  long long due = (long long)k * LAUNCH_INTERVAL_US;
+  return due < LAUNCH_WINDOW_US ? due : LAUNCH_WINDOW_US;
+}
+
+/**
+ * Launcher step: start every student whose launch time has come (at most
+ * LAUNCH_BATCH, so the workers keep serving other steps after the window
+ * closes), then wait for the next launch time. Due times are absolute, so
+ * pacing never drifts however late a step runs.
+ */
+void launch_students(Task *task) {
+  long long now = get_time_us();
+  for (int n = 0; n < LAUNCH_BATCH && next_launch < launch_order.size() &&
+                  launch_due_us(next_launch) <= now;
+       n++)
+    start_writing(&students[launch_order[next_launch++]]);
+
+  if (next_launch < launch_order.size())
+    pool_schedule_at(task, launch_due_us(next_launch));
+}
+
+/**
+ * Initialize students, shuffle the launch order and set the start time for
+ * the simulation.
  */
 void initialize() {
+  students.reserve(N);
   for (int i = 1; i <= N; i++) {
     students.emplace_back(Student(i));
   }
 
-  // Initialize mutex lock
-  pthread_mutex_init(&output_lock, NULL);
-
-  start_time = std::chrono::high_resolution_clock::now(); // Reset start time
+  // Fisher-Yates shuffle: every order equally likely, one draw per student
+  launch_order.resize(N);
+  for (int i = 0; i < N; i++)
+    launch_order[i] = i;
+  SimRng *rng = sim_thread_rng();
+  for (int i = N - 1; i > 0; i--) {
+    int j = (int)sim_note_draw(rng, (long long)((*rng)() % (i + 1)));
+    std::swap(launch_order[i], launch_order[j]);
+  }
+  next_launch = 0;
+
+  // Timed waits run on the monotonic clock, like get_time_us, so a wall
+  // clock step cannot stretch or cut a worker's sleep
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_mutex_init(&pool_mutex, NULL);
+  pthread_cond_init(&pool_cond, &attr);
+  pthread_condattr_destroy(&attr);
+  pool_seq = 0;
+  students_left = N;
+
+  start_time = std::chrono::steady_clock::now(); // Reset start time
 }
 
 /**
- * Thread function for student activities.
- * Simulates the student's report writing and reaching the print station.
- * @param arg Pointer to a Student object.
+ * Pool worker: run due steps until every student has arrived, sleeping
+ * until the earliest step is due in between.
  */
-void *student_activities(void *arg) {
-  Student *student = (Student *)arg;
-
-  write_output("Student " + std::to_string(student->id) +
-               " started writing for " + std::to_string(student->writing_time) +
-               " ms at " + std::to_string(get_time()) + " ms\n");
-  usleep(student->writing_time * SLEEP_MULTIPLIER); // Simulate writing time
-  write_output("Student " + std::to_string(student->id) +
-               " finished writing at " + std::to_string(get_time()) + " ms\n");
+void *pool_worker(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&pool_mutex);
+  while (students_left > 0) {
+    if (pool_timers.empty()) {
+      pthread_cond_wait(&pool_cond, &pool_mutex);
+      continue;
+    }
 
-  usleep((get_random_number() % WALKING_TO_PRINTER + 1) *
-         SLEEP_MULTIPLIER); // Simulate walking to printer
-  start_printing(student);  // Student reaches the printing station
+    long long wait_us = pool_timers.top().due_us - get_time_us();
+    if (wait_us > 0) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      deadline.tv_sec += wait_us / 1000000;
+      deadline.tv_nsec += (wait_us % 1000000) * 1000;
+      if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+      }
+      pthread_cond_timedwait(&pool_cond, &pool_mutex, &deadline);
+      continue;
+    }
 
+    Task *task = pool_timers.top().task;
+    pool_timers.pop();
+    pthread_mutex_unlock(&pool_mutex);
+    task->run(task);
+    pthread_mutex_lock(&pool_mutex);
+  }
+  pthread_mutex_unlock(&pool_mutex);
   return NULL;
 }
 
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    std::cout << "Usage: ./a.out <input_file> <output_file>" << std::endl;
+  if (argc < 3) {
+    std::cout << "Usage: ./a.out <input_file> <output_file> [--seed S] "
+                 "[--draws FILE] [--workers W]"
+              << std::endl;
     return 0;
   }
 
+  bool seeded = false;
+  int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      uint64_t seed;
+      if (sim_random_parse_seed(argv[++i], &seed) != 0) {
+        std::cout << "Invalid seed " << argv[i] << std::endl;
+        return 1;
+      }
+      sim_random_seed(seed);
+      seeded = true;
+    } else if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc) {
+      if (sim_random_record(argv[++i]) != 0) {
+        std::cout << "Cannot open draws file " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+      workers = atoi(argv[++i]);
+      if (workers <= 0) {
+        std::cout << "Invalid worker count " << argv[i] << std::endl;
+        return 1;
+      }
+    } else {
+      std::cout << "Unknown option " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+  if (!seeded)
+    sim_random_seed_randomly();
+  if (workers <= 0)
+    workers = 1;
+
   // File handling for input and output redirection
   std::ifstream inputFile(argv[1]);
   std::streambuf *cinBuffer = std::cin.rdbuf(); // Save original std::cin buffer
   std::cin.rdbuf(inputFile.rdbuf()); // Redirect std::cin to input file
 
-  std::ofstream outputFile(argv[2]);
-  std::streambuf *coutBuffer = std::cout.rdbuf(); // Save original cout buffer
-  std::cout.rdbuf(outputFile.rdbuf()); // Redirect cout to output file
+  if (async_log_open(&output_log, argv[2]) != 0) {
+    std::cout << "Cannot open output file " << argv[2] << std::endl;
+    return 1;
+  }
 
   // Read number of students from input file
   std::cin >> N;
 
-  pthread_t student_threads[N]; // Array to hold student threads
-
-  initialize(); // Initialize students and mutex lock
-
-  int remainingStudents = N;
-  bool started[N];
-
-  // start student threads randomly
-  while (remainingStudents) {
-    int randomStudent = get_random_number() % N;
-    if (!started[randomStudent]) {
-      started[randomStudent] = true;
-      pthread_create(&student_threads[randomStudent], NULL, student_activities,
-                     &students[randomStudent]);
-      remainingStudents--;
-      usleep(1000); // sleep for 1 ms
-      if (get_time() >
-          7000) { // if more than 7 seconds is passed, initialize the rest
-        break;
-      }
-    }
+  if (N <= 0) {
+    std::cout << "Invalid number of students" << std::endl;
+    return 1;
   }
 
-  // after waiting for 7(our choice) secs, start the remaining student threadss
-  for (int i = 0; i < N; i++) {
-    if (!started[i]) {
-      pthread_create(&student_threads[i], NULL, student_activities,
-                     &students[i]);
-    }
-  }
+  initialize(); // Initialize students and the launch order
 
-  // Wait for all student threads to finish
-  for (int i = 0; i < N; i++) {
-    pthread_join(student_threads[i], NULL);
+  // The launcher starts the first student right away and paces the rest
+  launcher.run = launch_students;
+  pool_schedule_at(&launcher, 0);
+
+  // Run every student's steps on the pool; workers return once all arrived
+  std::vector<pthread_t> worker_threads(workers);
+  for (int i = 0; i < workers; i++) {
+    pthread_create(&worker_threads[i], NULL, pool_worker, NULL);
+  }
+  for (int i = 0; i < workers; i++) {
+    pthread_join(worker_threads[i], NULL);
   }
 
-  // Restore std::cin and cout to their original states (console)
+  // Flush the remaining lines and restore std::cin (console)
+  async_log_close(&output_log);
   std::cin.rdbuf(cinBuffer);
-  std::cout.rdbuf(coutBuffer);
+
+  sim_random_report(stderr);
+  sim_random_close();
 
   return 0;
 }
@@ -0,0 +1,287 @@
+/*
+  Swappable synchronization backends for the operative simulations.
+
+  The model both simulations share (stations.h seats, per-unit completion)
+  needs three primitives: a counting semaphore for station seats, a one-shot
+  latch a unit's members count down and its leader waits on, and a barrier.
+  Each comes in three implementations picked at runtime:
+
+    posix - sem_t, pthread mutex + condition variable, pthread_barrier_t
+    std   - C++20 std::counting_semaphore, std::latch, std::barrier
+            (only when built with -std=c++20 or later)
+    futex - the semaphore is futex_sync.h's FutexSem (spins adaptively
+            before parking); the latch and barrier wait on their own
+            counters with futex(2) (futex.h)
+
+  Every primitive counts its contended operations (a semaphore wait or latch
+  wait that had to block), which sync_bench.cpp reports per backend.
+*/
+
+#ifndef SYNC_BACKEND_H
+#define SYNC_BACKEND_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <string.h>
+
+#include "futex_sync.h"
+
+#if __cplusplus >= 202002L && __has_include(<semaphore>) &&                    \
+    __has_include(<latch>) && __has_include(<barrier>)
+#define SYNC_HAVE_STD 1
+#include <barrier>
+#include <latch>
+#include <semaphore>
+#else
+#define SYNC_HAVE_STD 0
+#endif
+
+enum SyncBackend { SYNC_POSIX, SYNC_STD, SYNC_FUTEX };
+
+static const char *sync_backend_names[] = {"posix", "std", "futex"};
+
+static inline int sync_backend_available(int backend) {
+  return backend != SYNC_STD || SYNC_HAVE_STD;
+}
+
+/**
+ * Parse a backend name as accepted on the command line.
+ * @return The backend, or -1 if the name is unknown or the backend was not
+ *         compiled in.
+ */
+static inline int sync_parse_backend(const char *name) {
+  for (int i = 0; i < 3; i++) {
+    if (strcmp(name, sync_backend_names[i]) == 0)
+      return sync_backend_available(i) ? i : -1;
+  }
+  return -1;
+}
+
+// Counting semaphore
+
+typedef struct {
+  int backend;
+  unsigned long long contended; // waits that had to block
+  sem_t posix;
+#if SYNC_HAVE_STD
+  std::counting_semaphore<> *std_sem;
+#endif
+  FutexSem futex;
+} SyncSemaphore;
+
+static inline void sync_sem_init(SyncSemaphore *s, int backend, int value) {
+  s->backend = backend;
+  s->contended = 0;
+  futex_sem_init(&s->futex, 0, value);
+  if (backend == SYNC_POSIX)
+    sem_init(&s->posix, 0, value);
+#if SYNC_HAVE_STD
+  s->std_sem =
+      backend == SYNC_STD ? new std::counting_semaphore<>(value) : NULL;
+#endif
+}
+
+static inline void sync_sem_destroy(SyncSemaphore *s) {
+  if (s->backend == SYNC_POSIX)
+    sem_destroy(&s->posix);
+#if SYNC_HAVE_STD
+  delete s->std_sem;
+#endif
+}
+
+/**
+ * Take a permit if one is free.
+ * @return 0 on success, -1 if the caller would have to wait.
+ */
+static inline int sync_sem_trywait(SyncSemaphore *s) {
+  switch (s->backend) {
+  case SYNC_POSIX:
+    return sem_trywait(&s->posix) == 0 ? 0 : -1;
+#if SYNC_HAVE_STD
+  case SYNC_STD:
+    return s->std_sem->try_acquire() ? 0 : -1;
+#endif
+  default:
+    return futex_sem_trywait(&s->futex);
+  }
+}
+
+static inline void sync_sem_wait(SyncSemaphore *s) {
+  if (sync_sem_trywait(s) == 0)
+    return;
+  __atomic_add_fetch(&s->contended, 1, __ATOMIC_RELAXED);
+
+  switch (s->backend) {
+  case SYNC_POSIX:
+    while (sem_wait(&s->posix) != 0)
+      ;
+    return;
+#if SYNC_HAVE_STD
+  case SYNC_STD:
+    s->std_sem->acquire();
+    return;
+#endif
+  default:
+    futex_sem_wait(&s->futex);
+  }
+}
+
+static inline void sync_sem_post(SyncSemaphore *s) {
+  switch (s->backend) {
+  case SYNC_POSIX:
+    sem_post(&s->posix);
+    return;
+#if SYNC_HAVE_STD
+  case SYNC_STD:
+    s->std_sem->release();
+    return;
+#endif
+  default:
+    futex_sem_post(&s->futex);
+  }
+}
+
+// One-shot latch: count members down, wait for zero
+
+typedef struct {
+  int backend;
+  int remaining; // kept by every backend, so callers can read progress
+  unsigned long long contended;
+  pthread_mutex_t lock; // posix
+  pthread_cond_t done;
+#if SYNC_HAVE_STD
+  std::latch *std_latch;
+#endif
+} SyncLatch;
+
+static inline void sync_latch_init(SyncLatch *l, int backend, int count) {
+  l->backend = backend;
+  l->remaining = count;
+  l->contended = 0;
+  if (backend == SYNC_POSIX) {
+    pthread_mutex_init(&l->lock, NULL);
+    pthread_cond_init(&l->done, NULL);
+  }
+#if SYNC_HAVE_STD
+  l->std_latch = backend == SYNC_STD ? new std::latch(count) : NULL;
+#endif
+}
+
+static inline void sync_latch_destroy(SyncLatch *l) {
+  if (l->backend == SYNC_POSIX) {
+    pthread_mutex_destroy(&l->lock);
+    pthread_cond_destroy(&l->done);
+  }
+#if SYNC_HAVE_STD
+  delete l->std_latch;
+#endif
+}
+
+/**
+ * Count one member down.
+ * @return 1 for the member whose count-down reached zero, else 0.
+ */
+static inline int sync_latch_count_down(SyncLatch *l) {
+  int last = __atomic_sub_fetch(&l->remaining, 1, __ATOMIC_ACQ_REL) == 0;
+  switch (l->backend) {
+  case SYNC_POSIX:
+    if (last) {
+      pthread_mutex_lock(&l->lock);
+      pthread_cond_broadcast(&l->done);
+      pthread_mutex_unlock(&l->lock);
+    }
+    break;
+#if SYNC_HAVE_STD
+  case SYNC_STD:
+    l->std_latch->count_down();
+    break;
+#endif
+  default:
+    if (last)
+      futex_wake_all(&l->remaining);
+  }
+  return last;
+}
+
+static inline void sync_latch_wait(SyncLatch *l) {
+  if (__atomic_load_n(&l->remaining, __ATOMIC_ACQUIRE) == 0)
+    return;
+  __atomic_add_fetch(&l->contended, 1, __ATOMIC_RELAXED);
+
+  switch (l->backend) {
+  case SYNC_POSIX:
+    pthread_mutex_lock(&l->lock);
+    while (__atomic_load_n(&l->remaining, __ATOMIC_ACQUIRE) != 0)
+      pthread_cond_wait(&l->done, &l->lock);
+    pthread_mutex_unlock(&l->lock);
+    return;
+#if SYNC_HAVE_STD
+  case SYNC_STD:
+    l->std_latch->wait();
+    return;
+#endif
+  default:
+    int seen;
+    while ((seen = __atomic_load_n(&l->remaining, __ATOMIC_ACQUIRE)) != 0)
+      futex_wait(&l->remaining, seen);
+  }
+}
+
+// Reusable barrier for a fixed number of threads
+
+typedef struct {
+  int backend;
+  int count;
+  pthread_barrier_t posix;
+#if SYNC_HAVE_STD
+  std::barrier<> *std_barrier;
+#endif
+  int arrived;    // futex: threads in the current phase
+  int generation; // futex: bumped when a phase completes
+} SyncBarrier;
+
+static inline void sync_barrier_init(SyncBarrier *b, int backend, int count) {
+  b->backend = backend;
+  b->count = count;
+  b->arrived = 0;
+  b->generation = 0;
+  if (backend == SYNC_POSIX)
+    pthread_barrier_init(&b->posix, NULL, count);
+#if SYNC_HAVE_STD
+  b->std_barrier = backend == SYNC_STD ? new std::barrier<>(count) : NULL;
+#endif
+}
+
+static inline void sync_barrier_destroy(SyncBarrier *b) {
+  if (b->backend == SYNC_POSIX)
+    pthread_barrier_destroy(&b->posix);
+#if SYNC_HAVE_STD
+  delete b->std_barrier;
+#endif
+}
+
+static inline void sync_barrier_wait(SyncBarrier *b) {
+  switch (b->backend) {
+  case SYNC_POSIX:
+    pthread_barrier_wait(&b->posix);
+    return;
+#if SYNC_HAVE_STD
+  case SYNC_STD:
+    b->std_barrier->arrive_and_wait();
+    return;
+#endif
+  default:
+    int gen = __atomic_load_n(&b->generation, __ATOMIC_ACQUIRE);
+    if (__atomic_add_fetch(&b->arrived, 1, __ATOMIC_ACQ_REL) == b->count) {
+      // Nobody arrives for the next phase before generation moves on
+      __atomic_store_n(&b->arrived, 0, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&b->generation, 1, __ATOMIC_RELEASE);
+      futex_wake_all(&b->generation);
+      return;
+    }
+    while (__atomic_load_n(&b->generation, __ATOMIC_ACQUIRE) == gen)
+      futex_wait(&b->generation, gen);
+  }
+}
+
+#endif
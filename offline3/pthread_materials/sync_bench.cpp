@@ -0,0 +1,254 @@
+/*
+  Synchronization backend benchmark for the operative model.
+
+  Runs the model the simulations share, without their sleeps, once per
+  backend in sync_backend.h (posix, std, futex) and thread count. T
+  operative threads in units of M go through R rounds. In each round every
+  operative:
+    - waits at a barrier so the whole round arrives at once,
+    - takes a seat at a station (stations.h, S stations of capacity C, the
+      chosen dispatch policy),
+    - spins for W ns of "typing",
+    - releases the seat and counts its unit's latch down.
+  Each unit's leader (highest ID) then waits on the latch.
+
+  One CSV row per run:
+
+    backend,threads,M,stations,capacity,dispatch,rounds,work_ns,rep,wall_s,
+    seats_per_s,units_per_s,contended_pct,latch_waits,wait_p50_us,
+    wait_p99_us,user_s,sys_s,vol_ctx_switches,invol_ctx_switches
+
+  contended_pct is the share of seat acquisitions that had to block,
+  latch_waits how many leader waits found members still typing, wait_p50/
+  p99 the station wait percentiles (metrics.h). CPU time and context
+  switches are the process's getrusage deltas over the run.
+
+  Compilation:
+    g++ -std=c++20 -O2 -pthread sync_bench.cpp -o sync_bench
+
+  Usage:
+    ./sync_bench [--backend LIST] [--threads LIST] [--m M] [--stations S]
+                 [--capacity C] [--dispatch modulo|jsq|shared] [--rounds R]
+                 [--work NS] [--reps K] [--out FILE]
+
+    LIST is comma separated. Defaults: every compiled-in backend (std needs
+    -std=c++20), --threads 4,16,64 --m 4 --stations 4 --capacity 1
+    --dispatch modulo --rounds 2000 --work 2000 --reps 1, CSV on stdout.
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+#include <time.h>
+#include <vector>
+
+#include "bench_util.h"
+#include "stations.h"
+#include "sync_backend.h"
+
+typedef struct {
+  int threads, m, rounds;
+  long long work_ns;
+  StationSet stations;
+  SyncBarrier round_start;
+  SyncLatch *latches; // rounds x units
+} BenchRun;
+
+typedef struct {
+  BenchRun *run;
+  int id;
+} BenchOperative;
+
+static void spin_ns(long long ns) {
+  long long until = now_ns() + ns;
+  while (now_ns() < until)
+    ;
+}
+
+static void *bench_operative(void *arg) {
+  BenchOperative *op = (BenchOperative *)arg;
+  BenchRun *run = op->run;
+  int units = run->threads / run->m;
+  int unit = op->id / run->m;
+  int leader = op->id % run->m == run->m - 1;
+
+  for (int r = 0; r < run->rounds; r++) {
+    sync_barrier_wait(&run->round_start);
+
+    long long start_us;
+    int station = station_acquire(&run->stations,
+                                  op->id % run->stations.count, &start_us);
+    spin_ns(run->work_ns);
+    station_release(&run->stations, station, start_us);
+
+    SyncLatch *latch = &run->latches[r * units + unit];
+    sync_latch_count_down(latch);
+    if (leader)
+      sync_latch_wait(latch);
+  }
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<int> backends;
+  for (int b = 0; b < 3; b++) {
+    if (sync_backend_available(b))
+      backends.push_back(b);
+  }
+  std::vector<int> thread_counts = {4, 16, 64};
+  int m = 4, num_stations = 4, capacity = 1, dispatch = DISPATCH_MODULO;
+  int rounds = 2000, reps = 1;
+  long long work_ns = 2000;
+  const char *out_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (strcmp(arg, "--backend") == 0) {
+      backends.clear();
+      std::string name;
+      for (const char *p = value;; p++) {
+        if (*p == ',' || *p == '\0') {
+          int b = sync_parse_backend(name.c_str());
+          if (b < 0) {
+            fprintf(stderr, "Unknown or unavailable backend %s\n",
+                    name.c_str());
+            return 1;
+          }
+          backends.push_back(b);
+          name.clear();
+          if (*p == '\0')
+            break;
+        } else {
+          name += *p;
+        }
+      }
+    } else if (strcmp(arg, "--threads") == 0)
+      thread_counts = parse_list(value);
+    else if (strcmp(arg, "--m") == 0)
+      m = atoi(value);
+    else if (strcmp(arg, "--stations") == 0)
+      num_stations = atoi(value);
+    else if (strcmp(arg, "--capacity") == 0)
+      capacity = atoi(value);
+    else if (strcmp(arg, "--dispatch") == 0) {
+      dispatch = station_parse_dispatch(value);
+      if (dispatch < 0) {
+        fprintf(stderr, "Unknown dispatch policy %s\n", value);
+        return 1;
+      }
+    } else if (strcmp(arg, "--rounds") == 0)
+      rounds = atoi(value);
+    else if (strcmp(arg, "--work") == 0)
+      work_ns = atoll(value);
+    else if (strcmp(arg, "--reps") == 0)
+      reps = atoi(value);
+    else if (strcmp(arg, "--out") == 0)
+      out_path = value;
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+  }
+  if (m <= 0 || num_stations <= 0 || capacity <= 0 || rounds <= 0) {
+    fprintf(stderr, "M, stations, capacity and rounds must be positive\n");
+    return 1;
+  }
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Error opening %s\n", out_path);
+    return 1;
+  }
+
+  fprintf(out, "backend,threads,M,stations,capacity,dispatch,rounds,work_ns,"
+               "rep,wall_s,seats_per_s,units_per_s,contended_pct,latch_waits,"
+               "wait_p50_us,wait_p99_us,user_s,sys_s,vol_ctx_switches,"
+               "invol_ctx_switches\n");
+
+  for (int threads : thread_counts) {
+    if (threads <= 0 || threads % m != 0)
+      continue;
+    int units = threads / m;
+
+    for (int backend : backends)
+      for (int rep = 0; rep < reps; rep++) {
+        BenchRun run;
+        run.threads = threads;
+        run.m = m;
+        run.rounds = rounds;
+        run.work_ns = work_ns;
+        stations_init(&run.stations, num_stations, capacity, dispatch,
+                      backend);
+        sync_barrier_init(&run.round_start, backend, threads);
+        run.latches = (SyncLatch *)malloc((size_t)rounds * units *
+                                          sizeof(SyncLatch));
+        for (int i = 0; i < rounds * units; i++)
+          sync_latch_init(&run.latches[i], backend, m);
+
+        std::vector<BenchOperative> ops(threads);
+        std::vector<pthread_t> tids(threads);
+        struct rusage before, after;
+        getrusage(RUSAGE_SELF, &before);
+        long long start = now_ns();
+        for (int i = 0; i < threads; i++) {
+          ops[i].run = &run;
+          ops[i].id = i;
+          pthread_create(&tids[i], NULL, bench_operative, &ops[i]);
+        }
+        for (int i = 0; i < threads; i++)
+          pthread_join(tids[i], NULL);
+        double wall = (now_ns() - start) / 1e9;
+        getrusage(RUSAGE_SELF, &after);
+
+        // Seat contention from the semaphores, station waits from metrics.h
+        unsigned long long contended = run.stations.shared_slots.contended;
+        Histogram wait;
+        memset(&wait, 0, sizeof(wait));
+        for (int s = 0; s < run.stations.count; s++) {
+          contended += run.stations.sems[s].contended;
+          Histogram *h = &run.stations.stats[s].wait;
+          wait.count += h->count;
+          wait.sum_us += h->sum_us;
+          if (h->max_us > wait.max_us)
+            wait.max_us = h->max_us;
+          for (int b = 0; b < HIST_BUCKETS; b++)
+            wait.buckets[b] += h->buckets[b];
+        }
+        unsigned long long latch_waits = 0;
+        for (int i = 0; i < rounds * units; i++) {
+          latch_waits += run.latches[i].contended;
+          sync_latch_destroy(&run.latches[i]);
+        }
+        free(run.latches);
+        sync_barrier_destroy(&run.round_start);
+        stations_destroy(&run.stations);
+
+        long long seats = (long long)threads * rounds;
+        fprintf(out,
+                "%s,%d,%d,%d,%d,%s,%d,%lld,%d,%.6f,%.1f,%.1f,%.2f,%llu,%lld,"
+                "%lld,%.6f,%.6f,%ld,%ld\n",
+                sync_backend_names[backend], threads, m, num_stations,
+                capacity, station_dispatch_names[dispatch], rounds, work_ns,
+                rep, wall, seats / wall, (double)units * rounds / wall,
+                100.0 * contended / seats, latch_waits,
+                hist_percentile(&wait, 50), hist_percentile(&wait, 99),
+                tv_s(after.ru_utime) - tv_s(before.ru_utime),
+                tv_s(after.ru_stime) - tv_s(before.ru_stime),
+                after.ru_nvcsw - before.ru_nvcsw,
+                after.ru_nivcsw - before.ru_nivcsw);
+        fflush(out);
+      }
+  }
+
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
@@ -0,0 +1,291 @@
+/*
+  Timeline export for the operative simulation (2105110/2105110.cpp).
+
+  While a run is going, timeline_record() stores every event (the same
+  EventRecords as event_log.h, at microsecond resolution) in a chunked
+  append-only buffer: a slot is claimed with one atomic add, so recording
+  takes no lock. Staff review ends, which have no text line, are recorded
+  as TL_STAFF_REVIEW_DONE.
+
+  At the end timeline_write() pairs the events up into spans and writes
+  them as Chrome trace-event JSON, which chrome://tracing and
+  ui.perfetto.dev open directly:
+
+    Stations   one lane per station seat: "typing" spans, named after the
+               operative (with capacity C a station gets up to C lanes)
+    Staff      one lane per staff member: "review" spans (logbook read held)
+    Unit k     one lane for the unit: "members typing" (first member
+               arriving to the last one done), "logbook wait", "logbook
+               write"; one lane per member: "arrival" (run start to
+               arrival), "station wait", "typing", "unit wait" (done to the
+               unit being done)
+
+  Convoys show up as staircases of station waits, lock hand-off stalls as
+  gaps between one unit's logbook write and the next unit's.
+*/
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "event_log.h"
+
+enum TimelineType {
+  TL_STAFF_REVIEW_DONE = 100 // a = staff; timeline only, never printed
+};
+
+#define TIMELINE_CHUNK 65536       // records per chunk
+#define TIMELINE_MAX_CHUNKS 16384  // about a billion records
+
+typedef struct {
+  EventRecord **chunks;
+  unsigned long long next;    // next free slot
+  unsigned long long dropped; // records past the last chunk
+} Timeline;
+
+static inline void timeline_init(Timeline *tl) {
+  tl->chunks = (EventRecord **)calloc(TIMELINE_MAX_CHUNKS, sizeof(*tl->chunks));
+  tl->next = 0;
+  tl->dropped = 0;
+}
+
+static inline void timeline_destroy(Timeline *tl) {
+  for (int c = 0; c < TIMELINE_MAX_CHUNKS; c++)
+    free(tl->chunks[c]);
+  free(tl->chunks);
+}
+
+static inline void timeline_record(Timeline *tl, int type, long long time_us,
+                                   int a = 0, int b = 0) {
+  unsigned long long slot = __atomic_fetch_add(&tl->next, 1, __ATOMIC_RELAXED);
+  unsigned long long c = slot / TIMELINE_CHUNK;
+  if (c >= TIMELINE_MAX_CHUNKS) {
+    __atomic_add_fetch(&tl->dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  // The first thread into a chunk allocates it; racing losers free theirs
+  EventRecord *chunk = __atomic_load_n(&tl->chunks[c], __ATOMIC_ACQUIRE);
+  if (!chunk) {
+    EventRecord *fresh =
+        (EventRecord *)malloc(TIMELINE_CHUNK * sizeof(EventRecord));
+    if (__atomic_compare_exchange_n(&tl->chunks[c], &chunk, fresh, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      chunk = fresh;
+    else
+      free(fresh);
+  }
+
+  EventRecord *r = &chunk[slot % TIMELINE_CHUNK];
+  r->time_us = time_us;
+  r->type = type;
+  r->a = a;
+  r->b = b;
+  r->c = 0;
+}
+
+typedef struct {
+  int station; // 0-based
+  int operative;
+  long long begin_us, end_us;
+} TimelineSeatSpan;
+
+static inline void timeline_span(FILE *out, int *first, const char *name,
+                                 int pid, int tid, long long begin_us,
+                                 long long end_us) {
+  if (begin_us < 0 || end_us < begin_us)
+    return;
+  fprintf(out,
+          "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,"
+          "\"pid\":%d,\"tid\":%d}",
+          *first ? "" : ",", name, begin_us, end_us - begin_us, pid, tid);
+  *first = 0;
+}
+
+static inline void timeline_name(FILE *out, int *first, const char *what,
+                                 int pid, int tid, const char *fmt, int n,
+                                 int m = 0) {
+  char name[64];
+  snprintf(name, sizeof(name), fmt, n, m);
+  fprintf(out,
+          "%s\n{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+          "\"args\":{\"name\":\"%s\"}}",
+          *first ? "" : ",", what, pid, tid, name);
+  if (strcmp(what, "process_name") == 0)
+    fprintf(out,
+            ",\n{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":%d,"
+            "\"args\":{\"sort_index\":%d}}",
+            pid, pid);
+  *first = 0;
+}
+
+/**
+ * Pair the recorded events into spans and write them as Chrome trace JSON.
+ * N operatives in units of M, staff IDs up to staff_count.
+ * @return 0 on success, -1 if the file cannot be written.
+ */
+static inline int timeline_write(Timeline *tl, const char *path, int N, int M,
+                                 int staff_count) {
+  FILE *out = fopen(path, "w");
+  if (!out)
+    return -1;
+  setvbuf(out, NULL, _IOFBF, 1 << 20);
+
+  // Stable sort keeps causal order among events of the same microsecond
+  unsigned long long count = tl->next;
+  if (count > (unsigned long long)TIMELINE_CHUNK * TIMELINE_MAX_CHUNKS)
+    count = (unsigned long long)TIMELINE_CHUNK * TIMELINE_MAX_CHUNKS;
+  std::vector<EventRecord> events;
+  events.reserve(count);
+  for (unsigned long long i = 0; i < count; i++)
+    events.push_back(tl->chunks[i / TIMELINE_CHUNK][i % TIMELINE_CHUNK]);
+  std::stable_sort(events.begin(), events.end(),
+                   [](const EventRecord &x, const EventRecord &y) {
+                     return x.time_us < y.time_us;
+                   });
+
+  int units = N / M;
+  const int stations_pid = 1, staff_pid = 2, first_unit_pid = 3;
+  std::vector<long long> arrived(N + 1, -1), started(N + 1, -1),
+      done(N + 1, -1);
+  std::vector<int> station(N + 1, 0);
+  std::vector<long long> unit_done(units + 1, -1), write_start(units + 1, -1);
+  std::vector<long long> review_start(staff_count + 1, -1);
+  std::vector<TimelineSeatSpan> seats;
+  long long last_us = 0;
+  int first = 1;
+
+  fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  for (const EventRecord &e : events) {
+    long long t = e.time_us;
+    last_us = t;
+    switch (e.type) {
+    case EV_OPERATIVE_ARRIVED:
+      if (e.a < 1 || e.a > N)
+        break;
+      arrived[e.a] = t;
+      timeline_span(out, &first, "arrival", first_unit_pid + (e.a - 1) / M,
+                    e.a, 0, t);
+      break;
+    case EV_TYPING_STARTED:
+      if (e.a < 1 || e.a > N)
+        break;
+      started[e.a] = t;
+      station[e.a] = e.b - 1;
+      timeline_span(out, &first, "station wait",
+                    first_unit_pid + (e.a - 1) / M, e.a, arrived[e.a], t);
+      break;
+    case EV_TYPING_DONE:
+      if (e.a < 1 || e.a > N)
+        break;
+      done[e.a] = t;
+      timeline_span(out, &first, "typing", first_unit_pid + (e.a - 1) / M,
+                    e.a, started[e.a], t);
+      if (started[e.a] >= 0)
+        seats.push_back({station[e.a], e.a, started[e.a], t});
+      break;
+    case EV_UNIT_TYPING_DONE: {
+      if (e.a < 1 || e.a > units)
+        break;
+      int pid = first_unit_pid + e.a - 1;
+      long long first_arrival = -1;
+      unit_done[e.a] = t;
+      for (int op = (e.a - 1) * M + 1; op <= e.a * M; op++) {
+        timeline_span(out, &first, "unit wait", pid, op, done[op], t);
+        if (arrived[op] >= 0 &&
+            (first_arrival < 0 || arrived[op] < first_arrival))
+          first_arrival = arrived[op];
+      }
+      timeline_span(out, &first, "members typing", pid, 0, first_arrival, t);
+      break;
+    }
+    case EV_LEADER_LOGBOOK:
+      if (e.a < 1 || e.a > units)
+        break;
+      write_start[e.a] = t;
+      timeline_span(out, &first, "logbook wait", first_unit_pid + e.a - 1, 0,
+                    unit_done[e.a], t);
+      break;
+    case EV_UNIT_LOGGED:
+      if (e.a < 1 || e.a > units)
+        break;
+      timeline_span(out, &first, "logbook write", first_unit_pid + e.a - 1, 0,
+                    write_start[e.a], t);
+      break;
+    case EV_STAFF_REVIEW:
+      if (e.a >= 1 && e.a <= staff_count)
+        review_start[e.a] = t;
+      break;
+    case TL_STAFF_REVIEW_DONE:
+      if (e.a < 1 || e.a > staff_count)
+        break;
+      timeline_span(out, &first, "review", staff_pid, e.a, review_start[e.a],
+                    t);
+      review_start[e.a] = -1;
+      break;
+    }
+  }
+  // A review still holding the logbook when the run ended
+  for (int s = 1; s <= staff_count; s++)
+    timeline_span(out, &first, "review", staff_pid, s, review_start[s],
+                  last_us);
+
+  // Seats: hand each typing span to the first seat of its station that is
+  // free by then, so spans on one lane never overlap
+  std::sort(seats.begin(), seats.end(),
+            [](const TimelineSeatSpan &x, const TimelineSeatSpan &y) {
+              return x.begin_us < y.begin_us;
+            });
+  std::vector<std::vector<long long>> seat_free;
+  for (TimelineSeatSpan &s : seats) {
+    if (s.station < 0)
+      continue;
+    if ((int)seat_free.size() <= s.station)
+      seat_free.resize(s.station + 1);
+    std::vector<long long> &free_at = seat_free[s.station];
+    size_t seat = 0;
+    while (seat < free_at.size() && free_at[seat] > s.begin_us)
+      seat++;
+    if (seat == free_at.size())
+      free_at.push_back(0);
+    free_at[seat] = s.end_us;
+
+    char name[32];
+    snprintf(name, sizeof(name), "Operative %d", s.operative);
+    timeline_span(out, &first, name, stations_pid,
+                  s.station * 1000 + (int)seat + 1, s.begin_us, s.end_us);
+  }
+
+  // Lane names
+  timeline_name(out, &first, "process_name", stations_pid, 0, "Stations", 0);
+  for (size_t st = 0; st < seat_free.size(); st++)
+    for (size_t seat = 0; seat < seat_free[st].size(); seat++) {
+      if (seat_free[st].size() == 1)
+        timeline_name(out, &first, "thread_name", stations_pid,
+                      (int)(st * 1000 + seat + 1), "TS%d", (int)st + 1);
+      else
+        timeline_name(out, &first, "thread_name", stations_pid,
+                      (int)(st * 1000 + seat + 1), "TS%d seat %d", (int)st + 1,
+                      (int)seat + 1);
+    }
+  timeline_name(out, &first, "process_name", staff_pid, 0, "Staff", 0);
+  for (int s = 1; s <= staff_count; s++)
+    timeline_name(out, &first, "thread_name", staff_pid, s, "Staff %d", s);
+  for (int u = 1; u <= units; u++) {
+    int pid = first_unit_pid + u - 1;
+    timeline_name(out, &first, "process_name", pid, 0, "Unit %d", u);
+    timeline_name(out, &first, "thread_name", pid, 0, "Unit %d", u);
+    for (int op = (u - 1) * M + 1; op <= u * M; op++)
+      timeline_name(out, &first, "thread_name", pid, op, "Operative %d", op);
+  }
+  fprintf(out, "\n]}\n");
+
+  return fclose(out) == 0 ? 0 : -1;
+}
+
+#endif
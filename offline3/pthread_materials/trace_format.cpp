@@ -0,0 +1,72 @@
+/*
+  This program converts a binary event trace written by the operative
+  simulations (--trace <file>, see event_log.h) back into the usual text log.
+
+  Records are written to the trace in whatever order the drainer thread found
+  them in the per-thread rings, so they are sorted by timestamp here. The sort
+  is stable: events of one thread with the same timestamp keep their order.
+
+  Compilation:
+    g++ trace_format.cpp -o trace_format
+
+  Usage:
+    ./trace_format <trace_file> [output_file]
+*/
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "event_log.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("Usage: %s <trace_file> [output_file]\n", argv[0]);
+    return 1;
+  }
+
+  FILE *in = fopen(argv[1], "rb");
+  if (!in) {
+    printf("Error: Cannot open trace file %s\n", argv[1]);
+    return 1;
+  }
+
+  char magic[8];
+  uint32_t header[2];
+  if (fread(magic, 1, 8, in) != 8 || memcmp(magic, EVENT_TRACE_MAGIC, 8) != 0 ||
+      fread(header, sizeof(header), 1, in) != 1 ||
+      header[0] != sizeof(EventRecord)) {
+    printf("Error: %s is not an event trace\n", argv[1]);
+    fclose(in);
+    return 1;
+  }
+
+  std::vector<EventRecord> records;
+  EventRecord chunk[EVENT_BATCH];
+  size_t n;
+  while ((n = fread(chunk, sizeof(EventRecord), EVENT_BATCH, in)) > 0)
+    records.insert(records.end(), chunk, chunk + n);
+  fclose(in);
+
+  std::stable_sort(records.begin(), records.end(),
+                   [](const EventRecord &a, const EventRecord &b) {
+                     return a.time_us < b.time_us;
+                   });
+
+  FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+  if (!out) {
+    printf("Error: Cannot open output file %s\n", argv[2]);
+    return 1;
+  }
+
+  char line[160];
+  for (const EventRecord &r : records) {
+    event_format(&r, line, sizeof(line));
+    fputs(line, out);
+  }
+
+  if (out != stdout)
+    fclose(out);
+  return 0;
+}
@@ -0,0 +1,363 @@
+/*
+  xoshiro256** random numbers with jump-ahead streams and batch samplers
+  that fill whole arrays with SIMD.
+
+  Xoshiro256 is the scalar engine: 32 bytes of state, a period of 2^256 - 1,
+  a few shifts and xors per 64-bit output. It is a std
+  UniformRandomBitGenerator, so std:: distributions accept it too.
+
+  Streams: xoshiro_jump() advances an engine by 2^128 draws and
+  xoshiro_long_jump() by 2^192, in about the time of 256 draws.
+  xoshiro_stream(seed, i) is the seed's engine long-jumped i times, so
+  thread i can draw up to 2^192 numbers without ever overlapping thread j.
+
+  XoshiroBatch runs four engines in the lanes of a GCC vector (the same
+  vector_size(32) types as parallel_reduce.h; AVX2 when built with
+  -mavx2, two SSE2 halves otherwise). Its lanes are one stream jumped 0, 1,
+  2 and 3 times, so a batch built from xoshiro_stream(seed, i) stays inside
+  thread i's stream. The fill functions turn four 64-bit outputs at a time
+  into:
+    uniform      doubles in [0, 1), from the top 52 bits
+    exponential  -log(U) / rate, with a vectorized log (below)
+    poisson      PTRS transformed rejection (Hormann 1993) for lambda >= 10:
+                 four candidates per step, a cheap accept test that takes
+                 about 80% of them and a full test done in the same vectors;
+                 accepted lanes are copied out in order. Smaller lambdas use
+                 inversion by sequential search, one uniform per sample.
+
+  The vectorized log splits x into 2^e * m with m in [sqrt(1/2), sqrt(2))
+  and sums log m = 2 atanh((m - 1) / (m + 1)) to the t^13 term, which is
+  within 1e-12 of std::log for the normal positive doubles used here.
+
+  xoshiro_below(n) is a uniform integer in [0, n) without the modulo
+  (Lemire's multiply-shift). It is what code that reduces a Poisson draw
+  "% 21" to get a small delay actually wants: a Poisson(10000.234) is so
+  concentrated that the modulo only scrambles it into a roughly uniform
+  value, at the cost of a full Poisson sample.
+*/
+
+#ifndef XOSHIRO_H
+#define XOSHIRO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct Xoshiro256 {
+  uint64_t s[4];
+
+  // UniformRandomBitGenerator, so std:: distributions accept it
+  typedef uint64_t result_type;
+  static constexpr uint64_t min() { return 0; }
+  static constexpr uint64_t max() { return UINT64_MAX; }
+  uint64_t operator()();
+} Xoshiro256;
+
+static inline uint64_t xoshiro_rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t xoshiro_next(Xoshiro256 *x) {
+  uint64_t *s = x->s;
+  uint64_t result = xoshiro_rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = xoshiro_rotl(s[3], 45);
+  return result;
+}
+
+inline uint64_t Xoshiro256::operator()() { return xoshiro_next(this); }
+
+// Fill the state from a 64-bit seed with splitmix64, which never yields
+// the all-zero state
+static inline void xoshiro_seed(Xoshiro256 *x, uint64_t seed) {
+  for (int i = 0; i < 4; i++) {
+    uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    x->s[i] = z ^ (z >> 31);
+  }
+}
+
+static inline void xoshiro_jump_by(Xoshiro256 *x, const uint64_t poly[4]) {
+  uint64_t s[4] = {0, 0, 0, 0};
+  for (int i = 0; i < 4; i++)
+    for (int b = 0; b < 64; b++) {
+      if (poly[i] & (1ULL << b))
+        for (int j = 0; j < 4; j++)
+          s[j] ^= x->s[j];
+      xoshiro_next(x);
+    }
+  memcpy(x->s, s, sizeof(s));
+}
+
+// Advance by 2^128 draws
+static inline void xoshiro_jump(Xoshiro256 *x) {
+  static const uint64_t poly[4] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                   0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+  xoshiro_jump_by(x, poly);
+}
+
+// Advance by 2^192 draws
+static inline void xoshiro_long_jump(Xoshiro256 *x) {
+  static const uint64_t poly[4] = {0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+                                   0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+  xoshiro_jump_by(x, poly);
+}
+
+/**
+ * Stream index of a seed: streams are 2^192 draws apart, so they never
+ * overlap in practice. Costs index long jumps; build once per thread.
+ * @return The engine for the stream.
+ */
+static inline Xoshiro256 xoshiro_stream(uint64_t seed, unsigned index) {
+  Xoshiro256 x;
+  xoshiro_seed(&x, seed);
+  for (unsigned i = 0; i < index; i++)
+    xoshiro_long_jump(&x);
+  return x;
+}
+
+// Uniform double in [0, 1) from the top 53 bits
+static inline double xoshiro_uniform(Xoshiro256 *x) {
+  return (xoshiro_next(x) >> 11) * 0x1.0p-53;
+}
+
+/**
+ * Uniform integer in [0, n), n > 0, by multiply-shift with rejection of the
+ * few values that would make it uneven.
+ * @return The integer.
+ */
+static inline uint32_t xoshiro_below(Xoshiro256 *x, uint32_t n) {
+  uint64_t m = (xoshiro_next(x) >> 32) * n;
+  if ((uint32_t)m < n) {
+    uint32_t floor = (uint32_t)(-n) % n;
+    while ((uint32_t)m < floor)
+      m = (xoshiro_next(x) >> 32) * n;
+  }
+  return (uint32_t)(m >> 32);
+}
+
+// Batch engine
+//
+// The helpers below work in place through pointers: a 32-byte vector passed
+// or returned by value makes GCC warn about the AVX calling convention when
+// built without -mavx2 (parallel_reduce.h keeps its vectors local the same
+// way).
+
+#define XOSHIRO_LANES 4
+
+typedef uint64_t XoshiroVec __attribute__((vector_size(32)));
+typedef int64_t XoshiroVecI __attribute__((vector_size(32)));
+typedef double XoshiroVecD __attribute__((vector_size(32)));
+
+typedef struct {
+  XoshiroVec s0, s1, s2, s3; // word i of every lane's state
+} XoshiroBatch;
+
+/**
+ * Four lanes from one engine: lane j is base jumped j times (2^128 draws
+ * apart), so the lanes never overlap each other or base's long-jump streams.
+ */
+static inline void xoshiro_batch_init(XoshiroBatch *b, const Xoshiro256 *base) {
+  Xoshiro256 x = *base;
+  for (int j = 0; j < XOSHIRO_LANES; j++) {
+    b->s0[j] = x.s[0];
+    b->s1[j] = x.s[1];
+    b->s2[j] = x.s[2];
+    b->s3[j] = x.s[3];
+    xoshiro_jump(&x);
+  }
+}
+
+// One draw in every lane; the multiplies by 5 and 9 are shifts and adds
+static inline void xoshiro_batch_next(XoshiroBatch *b, XoshiroVec *out) {
+  XoshiroVec r = (b->s1 << 2) + b->s1;
+  r = (r << 7) | (r >> 57);
+  *out = (r << 3) + r;
+  XoshiroVec t = b->s1 << 17;
+  b->s2 ^= b->s0;
+  b->s3 ^= b->s1;
+  b->s1 ^= b->s2;
+  b->s0 ^= b->s3;
+  b->s2 ^= t;
+  b->s3 = (b->s3 << 45) | (b->s3 >> 19);
+}
+
+// [0, 1) from the top 52 bits: they become the mantissa of a double in [1, 2)
+static inline void xoshiro_batch_uniform(XoshiroBatch *b, XoshiroVecD *out) {
+  XoshiroVec bits;
+  xoshiro_batch_next(b, &bits);
+  bits = (bits >> 12) | 0x3ff0000000000000ULL;
+  memcpy(out, &bits, sizeof(bits));
+  *out -= 1.0;
+}
+
+// floor(x) for |x| < 2^51 (and -inf) without leaving the vector registers
+static inline void xoshiro_vfloor(XoshiroVecD *x) {
+  XoshiroVecD r = (*x + 0x1.8p52) - 0x1.8p52; // x rounded to nearest
+  *x = r > *x ? r - 1.0 : r;
+}
+
+// log(x) for normal positive x, lane-wise (see the top of the file)
+static inline void xoshiro_vlog(XoshiroVecD *x) {
+  XoshiroVecI bits;
+  memcpy(&bits, x, sizeof(bits));
+  XoshiroVecI e = ((bits >> 52) & 0x7ff) - 1023;
+  XoshiroVecI mbits = (bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL;
+  XoshiroVecD m;
+  memcpy(&m, &mbits, sizeof(m));
+  XoshiroVecI high = m > M_SQRT2; // -1 where m is halved
+  m = high ? m * 0.5 : m;
+  e -= high;
+
+  // e as a double: add it to the integer bits of 1.5 * 2^52
+  XoshiroVecI ebits = e + 0x4338000000000000LL;
+  XoshiroVecD ed;
+  memcpy(&ed, &ebits, sizeof(ed));
+  ed -= 0x1.8p52;
+
+  XoshiroVecD t = (m - 1.0) / (m + 1.0);
+  XoshiroVecD t2 = t * t;
+  XoshiroVecD p = t2 * (1.0 / 13) + 1.0 / 11;
+  p = p * t2 + 1.0 / 9;
+  p = p * t2 + 1.0 / 7;
+  p = p * t2 + 1.0 / 5;
+  p = p * t2 + 1.0 / 3;
+  p = p * t2 + 1.0;
+  *x = ed * M_LN2 + 2.0 * t * p;
+}
+
+// log Gamma(x) for x >= 1: Stirling's series at x + 6, shifted back
+static inline void xoshiro_vlgamma(XoshiroVecD *x) {
+  XoshiroVecD shift = *x * (*x + 1.0) * (*x + 2.0) * (*x + 3.0) *
+                      (*x + 4.0) * (*x + 5.0);
+  XoshiroVecD y = *x + 6.0;
+  XoshiroVecD iy = 1.0 / y;
+  XoshiroVecD iy2 = iy * iy;
+  XoshiroVecD series =
+      iy * (1.0 / 12 - iy2 * (1.0 / 360 - iy2 * (1.0 / 1260)));
+  XoshiroVecD log_y = y;
+  xoshiro_vlog(&log_y);
+  xoshiro_vlog(&shift);
+  *x = (y - 0.5) * log_y - y + 0.91893853320467274178 + series - shift;
+}
+
+// The fill loops store whole vectors and leave the last partial one to a
+// separate copy, so the loop body never calls memcpy with a variable size
+static inline void xoshiro_fill_u64(XoshiroBatch *b, uint64_t *out, size_t n) {
+  XoshiroVec v;
+  size_t i = 0;
+  for (; i + XOSHIRO_LANES <= n; i += XOSHIRO_LANES) {
+    xoshiro_batch_next(b, &v);
+    memcpy(out + i, &v, sizeof(v));
+  }
+  if (i < n) {
+    xoshiro_batch_next(b, &v);
+    memcpy(out + i, &v, (n - i) * sizeof(uint64_t));
+  }
+}
+
+static inline void xoshiro_fill_uniform(XoshiroBatch *b, double *out,
+                                        size_t n) {
+  XoshiroVecD v;
+  size_t i = 0;
+  for (; i + XOSHIRO_LANES <= n; i += XOSHIRO_LANES) {
+    xoshiro_batch_uniform(b, &v);
+    memcpy(out + i, &v, sizeof(v));
+  }
+  if (i < n) {
+    xoshiro_batch_uniform(b, &v);
+    memcpy(out + i, &v, (n - i) * sizeof(double));
+  }
+}
+
+// Exponential samples with the given rate (mean 1 / rate)
+static inline void xoshiro_fill_exponential(XoshiroBatch *b, double *out,
+                                            size_t n, double rate) {
+  double scale = -1.0 / rate;
+  XoshiroVecD v;
+  size_t i = 0;
+  for (; i < n; i += XOSHIRO_LANES) {
+    xoshiro_batch_uniform(b, &v);
+    v = 1.0 - v; // (0, 1], so the log is finite
+    xoshiro_vlog(&v);
+    v *= scale;
+    if (i + XOSHIRO_LANES > n)
+      break;
+    memcpy(out + i, &v, sizeof(v));
+  }
+  if (i < n)
+    memcpy(out + i, &v, (n - i) * sizeof(double));
+}
+
+// Poisson samples with mean lambda > 0
+static inline void xoshiro_fill_poisson(XoshiroBatch *b, int *out, size_t n,
+                                        double lambda) {
+  size_t count = 0;
+  if (lambda < 10) {
+    // Inversion: walk the CDF until it passes one uniform
+    double p0 = exp(-lambda);
+    while (count < n) {
+      XoshiroVecD u;
+      xoshiro_batch_uniform(b, &u);
+      for (int j = 0; j < XOSHIRO_LANES && count < n; j++) {
+        int k = 0;
+        double p = p0, cdf = p0;
+        while (u[j] > cdf && p > 0) {
+          k++;
+          p *= lambda / k;
+          cdf += p;
+        }
+        out[count++] = k;
+      }
+    }
+    return;
+  }
+
+  // PTRS constants
+  double slam = sqrt(lambda);
+  double loglam = log(lambda);
+  double bb = 0.931 + 2.53 * slam;
+  double a = -0.059 + 0.02483 * bb;
+  double log_invalpha = log(1.1239 + 1.1328 / (bb - 3.4));
+  double vr = 0.9277 - 3.6224 / (bb - 2);
+
+  while (count < n) {
+    XoshiroVecD u, v;
+    xoshiro_batch_uniform(b, &u);
+    xoshiro_batch_uniform(b, &v);
+    u -= 0.5;
+    v = 1.0 - v; // (0, 1]
+    XoshiroVecD us = 0.5 - (u < 0 ? -u : u);
+    XoshiroVecD k = (2 * a / us + bb) * u + lambda + 0.43;
+    xoshiro_vfloor(&k);
+
+    XoshiroVecI accept = (us >= 0.07) & (v <= vr);
+    XoshiroVecI reject = (k < 0) | ((us < 0.013) & (v > us));
+    XoshiroVecI undecided = ~accept & ~reject;
+    if (undecided[0] | undecided[1] | undecided[2] | undecided[3]) {
+      XoshiroVecD log_v = v;
+      XoshiroVecD log_h = a / (us * us) + bb;
+      XoshiroVecD kk = k < 0 ? 0.0 : k; // keep rejected lanes finite
+      XoshiroVecD lg = kk + 1.0;
+      xoshiro_vlog(&log_v);
+      xoshiro_vlog(&log_h);
+      xoshiro_vlgamma(&lg);
+      XoshiroVecD lhs = log_v + log_invalpha - log_h;
+      XoshiroVecD rhs = -lambda + kk * loglam - lg;
+      accept |= undecided & (lhs <= rhs);
+    }
+
+    for (int j = 0; j < XOSHIRO_LANES && count < n; j++)
+      if (accept[j])
+        out[count++] = (int)k[j];
+  }
+}
+
+#endif